@@ -0,0 +1,53 @@
+/*
+ * Host build internal interface between HAL modules and host main.
+ */
+#ifndef _HOST_HAL_H
+#define _HOST_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Virtual time in nanoseconds since boot */
+uint64_t host_time_ns(void);
+
+/* Advance virtual time, calling alarm callbacks which become due */
+void host_advance_to(uint64_t t_ns);
+void host_advance_ns(uint64_t ns);
+
+/* One shot alarm at absolute virtual time, used by the peripheral models */
+void host_alarm_at_ns(uint64_t t_ns, int64_t (*callback)(int32_t id, void *user_data), void *user_data);
+
+/*
+ * End of run. host_stop() is called at the next sleep, so that the
+ * screen is captured between frames, not in the middle of drawing.
+ */
+void host_request_stop(void);
+void host_stop(void);
+
+/* SPI bus statistics of LCD port */
+typedef struct {
+    uint64_t bytes;		/* bytes sent to LCD */
+    uint64_t busy_ns;		/* time SPI was shifting data */
+    uint32_t transactions;	/* CS assertions */
+    uint32_t dma_transfers;	/* DMA transfers started to SPI */
+} HOST_SPI_STATS;
+
+extern HOST_SPI_STATS host_spi_stats;
+
+/* ILI9341 panel model */
+void ili9341_model_write(uint8_t data, bool dc);
+uint8_t ili9341_model_read(void);
+uint16_t ili9341_model_get_pixel(int x, int y);
+int ili9341_model_save_ppm(const char *path);
+uint32_t ili9341_model_checksum(void);
+
+typedef struct {
+    uint32_t commands;		/* command bytes */
+    uint32_t windows;		/* column/page address set */
+    uint64_t pixels;		/* pixels written to GRAM */
+    uint32_t reads;		/* memory read commands */
+} ILI9341_STATS;
+
+extern ILI9341_STATS ili9341_stats;
+
+#endif
@@ -0,0 +1,551 @@
+/*
+ * Pico Games host build
+ *
+ * GPIO, SPI, DMA, interrupts, PWM, queue and watchdog.
+ * LCD port pins are taken from hwconfig.h and connected to the panel model.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "hardware/watchdog.h"
+#include "hwconfig.h"
+#include "hal.h"
+
+/* Time consumed by each poll of a busy flag */
+#define	POLL_STEP_NS	100
+
+#define	NUM_GPIOS	48
+
+spi_inst_t host_spi[2];
+HOST_SPI_STATS host_spi_stats;
+
+static bool gpio_value[NUM_GPIOS];
+
+void gpio_init(unsigned int gpio)
+{
+    gpio_value[gpio] = false;
+}
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn)
+{
+}
+
+void gpio_set_dir(unsigned int gpio, bool out)
+{
+}
+
+void gpio_pull_up(unsigned int gpio)
+{
+    gpio_value[gpio] = true;
+}
+
+void gpio_put(unsigned int gpio, bool value)
+{
+    if (gpio == LCD_CS && !value && gpio_value[gpio])
+        host_spi_stats.transactions++;
+    gpio_value[gpio] = value;
+}
+
+bool gpio_get(unsigned int gpio)
+{
+    return gpio_value[gpio];
+}
+
+uint32_t gpio_get_all(void)
+{
+    uint32_t v = 0;
+
+    for (int i = 0; i < 32; i++)
+        if (gpio_value[i])
+            v |= 1u << i;
+    return v;
+}
+
+/*
+ * SPI
+ */
+unsigned int spi_init(spi_inst_t *spi, unsigned int baudrate)
+{
+    spi->baudrate = baudrate;
+    spi->data_bits = 8;
+    spi->busy_until = 0;
+    return baudrate;
+}
+
+void spi_set_format(spi_inst_t *spi, unsigned int data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order)
+{
+    if (host_time_ns() < spi->busy_until)
+    {
+        fprintf(stderr, "host: spi_set_format() while SPI is busy\n");
+        abort();
+    }
+    spi->data_bits = data_bits;
+}
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi)
+{
+    return &spi->hw;
+}
+
+unsigned int spi_get_index(const spi_inst_t *spi)
+{
+    return spi == spi1 ? 1 : 0;
+}
+
+unsigned int spi_get_dreq(spi_inst_t *spi, bool is_tx)
+{
+    return 24 + spi_get_index(spi) * 2 + (is_tx ? 0 : 1);
+}
+
+static uint64_t frame_ns(const spi_inst_t *spi, size_t frames)
+{
+    return (uint64_t)frames * spi->data_bits * 1000000000ull / spi->baudrate;
+}
+
+/*
+ * Queue frames on SPI, starting after the current transfer.
+ * Returns the time when the last frame has been sent.
+ */
+static uint64_t spi_queue_frames(spi_inst_t *spi, size_t frames)
+{
+    uint64_t start = host_time_ns();
+    uint64_t ns = frame_ns(spi, frames);
+
+    if (spi->busy_until > start)
+        start = spi->busy_until;
+    spi->busy_until = start + ns;
+    if (spi == SPICH)
+        host_spi_stats.busy_ns += ns;
+    return spi->busy_until;
+}
+
+static void spi_send_frame(spi_inst_t *spi, uint32_t v)
+{
+    if (spi != SPICH || gpio_value[LCD_CS])
+        return;
+    if (spi->data_bits > 8)
+    {
+        ili9341_model_write(v >> 8, gpio_value[LCD_DC]);
+        host_spi_stats.bytes++;
+    }
+    ili9341_model_write(v, gpio_value[LCD_DC]);
+    host_spi_stats.bytes++;
+}
+
+bool spi_is_busy(const spi_inst_t *spi)
+{
+    host_advance_ns(POLL_STEP_NS);
+    return host_time_ns() < spi->busy_until;
+}
+
+bool spi_is_readable(const spi_inst_t *spi)
+{
+    /* Received data is not kept */
+    return false;
+}
+
+bool spi_is_writable(const spi_inst_t *spi)
+{
+    return true;
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        spi_send_frame(spi, src[i]);
+    host_advance_to(spi_queue_frames(spi, len));
+    return len;
+}
+
+int spi_write16_blocking(spi_inst_t *spi, const uint16_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        spi_send_frame(spi, src[i]);
+    host_advance_to(spi_queue_frames(spi, len));
+    return len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        dst[i] = (spi == SPICH && !gpio_value[LCD_CS]) ? ili9341_model_read() : 0;
+    host_advance_to(spi_queue_frames(spi, len));
+    return len;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len)
+{
+    /* Touch controller is not simulated, it never reports a touch */
+    memset(dst, 0, len);
+    host_advance_to(spi_queue_frames(spi, len));
+    return len;
+}
+
+/*
+ * DMA
+ */
+typedef struct {
+    bool claimed;
+    dma_channel_config config;
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    unsigned int transfer_count;
+    uint64_t busy_until;
+    bool irq0_enabled;
+    bool irq0_status;
+} DMA_CHANNEL;
+
+static DMA_CHANNEL dma_channels[NUM_DMA_CHANNELS];
+
+/* DREQ numbers of PWM wrap, as on RP2350 */
+#define DREQ_PWM_WRAP0 32
+
+static uint64_t pwm_wrap_ns(unsigned int slice_num);
+
+static int64_t dma_done_alarm(alarm_id_t id, void *user_data)
+{
+    DMA_CHANNEL *ch = user_data;
+
+    if (ch->config.chain_to != ch - dma_channels)
+        dma_channel_start(ch->config.chain_to);
+    if (ch->irq0_enabled)
+    {
+        ch->irq0_status = true;
+        host_raise_irq(DMA_IRQ_0);
+    }
+    return 0;
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (int i = 0; i < NUM_DMA_CHANNELS; i++)
+    {
+        if (!dma_channels[i].claimed)
+        {
+            dma_channels[i].claimed = true;
+            return i;
+        }
+    }
+    if (required)
+    {
+        fprintf(stderr, "host: no free DMA channel\n");
+        abort();
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(unsigned int channel)
+{
+    dma_channels[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(unsigned int channel)
+{
+    dma_channel_config c;
+
+    memset(&c, 0, sizeof(c));
+    c.size = DMA_SIZE_32;
+    c.read_increment = true;
+    c.write_increment = false;
+    c.dreq = 0x3f;		/* unpaced */
+    c.chain_to = channel;
+    c.enable = true;
+    return c;
+}
+
+static spi_inst_t *spi_of_dr(volatile void *addr)
+{
+    for (int i = 0; i < 2; i++)
+        if (addr == &host_spi[i].hw.dr)
+            return &host_spi[i];
+    return NULL;
+}
+
+static uintptr_t ring_addr(uintptr_t base, uintptr_t offset, unsigned int size_bits)
+{
+    uintptr_t mask;
+
+    if (size_bits == 0)
+        return base + offset;
+    mask = ((uintptr_t)1 << size_bits) - 1;
+    return (base & ~mask) | ((base + offset) & mask);
+}
+
+static uint32_t dma_read(uintptr_t addr, unsigned int size)
+{
+    switch (size)
+    {
+    case DMA_SIZE_8:
+        return *(const volatile uint8_t *)addr;
+    case DMA_SIZE_16:
+        return *(const volatile uint16_t *)addr;
+    default:
+        return *(const volatile uint32_t *)addr;
+    }
+}
+
+static void dma_write(uintptr_t addr, unsigned int size, uint32_t v)
+{
+    switch (size)
+    {
+    case DMA_SIZE_8:
+        *(volatile uint8_t *)addr = v;
+        break;
+    case DMA_SIZE_16:
+        *(volatile uint16_t *)addr = v;
+        break;
+    default:
+        *(volatile uint32_t *)addr = v;
+        break;
+    }
+}
+
+void dma_channel_start(unsigned int channel)
+{
+    DMA_CHANNEL *ch = &dma_channels[channel];
+    const dma_channel_config *c = &ch->config;
+    unsigned int width = 1u << c->size;
+    spi_inst_t *spi = spi_of_dr(ch->write_addr);
+    uintptr_t rd = (uintptr_t)ch->read_addr;
+    uintptr_t wr = (uintptr_t)ch->write_addr;
+
+    if (!c->enable)
+        return;
+    for (unsigned int i = 0; i < ch->transfer_count; i++)
+    {
+        uintptr_t roff = c->read_increment ? (uintptr_t)i * width : 0;
+        uintptr_t woff = c->write_increment ? (uintptr_t)i * width : 0;
+        uint32_t v;
+
+        v = dma_read(c->ring_write ? rd + roff : ring_addr(rd, roff, c->ring_size_bits), c->size);
+        if (spi)
+            spi_send_frame(spi, v);
+        else
+            dma_write(c->ring_write ? ring_addr(wr, woff, c->ring_size_bits) : wr + woff, c->size, v);
+    }
+    if (spi)
+    {
+        ch->busy_until = spi_queue_frames(spi, ch->transfer_count);
+        if (spi == SPICH)
+            host_spi_stats.dma_transfers++;
+    }
+    else if (c->dreq >= DREQ_PWM_WRAP0 && c->dreq < DREQ_PWM_WRAP0 + NUM_PWM_SLICES)
+        ch->busy_until = host_time_ns() + ch->transfer_count * pwm_wrap_ns(c->dreq - DREQ_PWM_WRAP0);
+    else
+        ch->busy_until = host_time_ns();
+    if (ch->irq0_enabled || c->chain_to != channel)
+        host_alarm_at_ns(ch->busy_until, dma_done_alarm, ch);
+}
+
+void dma_channel_set_read_addr(unsigned int channel, const volatile void *read_addr, bool trigger)
+{
+    dma_channels[channel].read_addr = read_addr;
+    if (trigger)
+        dma_channel_start(channel);
+}
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, unsigned int transfer_count, bool trigger)
+{
+    DMA_CHANNEL *ch = &dma_channels[channel];
+
+    ch->config = *config;
+    ch->write_addr = write_addr;
+    ch->read_addr = read_addr;
+    ch->transfer_count = transfer_count;
+    if (trigger)
+        dma_channel_start(channel);
+}
+
+bool dma_channel_is_busy(unsigned int channel)
+{
+    host_advance_ns(POLL_STEP_NS);
+    return host_time_ns() < dma_channels[channel].busy_until;
+}
+
+void dma_channel_wait_for_finish_blocking(unsigned int channel)
+{
+    host_advance_to(dma_channels[channel].busy_until);
+}
+
+void dma_channel_set_irq0_enabled(unsigned int channel, bool enabled)
+{
+    dma_channels[channel].irq0_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(unsigned int channel)
+{
+    return dma_channels[channel].irq0_status;
+}
+
+void dma_channel_acknowledge_irq0(unsigned int channel)
+{
+    dma_channels[channel].irq0_status = false;
+}
+
+/*
+ * Interrupts
+ */
+#define	MAX_SHARED_HANDLERS	4
+
+static irq_handler_t irq_handlers[NUM_IRQS][MAX_SHARED_HANDLERS];
+static bool irq_enabled[NUM_IRQS];
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler)
+{
+    memset(irq_handlers[num], 0, sizeof(irq_handlers[num]));
+    irq_handlers[num][0] = handler;
+}
+
+void irq_add_shared_handler(unsigned int num, irq_handler_t handler, uint8_t order_priority)
+{
+    for (int i = 0; i < MAX_SHARED_HANDLERS; i++)
+    {
+        if (irq_handlers[num][i] == NULL)
+        {
+            irq_handlers[num][i] = handler;
+            return;
+        }
+    }
+    fprintf(stderr, "host: too many handlers for IRQ %u\n", num);
+    abort();
+}
+
+void irq_set_enabled(unsigned int num, bool enabled)
+{
+    irq_enabled[num] = enabled;
+}
+
+void host_raise_irq(unsigned int num)
+{
+    if (!irq_enabled[num])
+        return;
+    for (int i = 0; i < MAX_SHARED_HANDLERS && irq_handlers[num][i]; i++)
+        irq_handlers[num][i]();
+}
+
+/*
+ * PWM, sound output is not simulated. DMA paced by wrap DREQ takes
+ * time of the wrap period for each transfer.
+ */
+typedef struct {
+    uint16_t wrap;
+    uint16_t level[2];
+    uint8_t div_int;
+    uint8_t div_frac;
+    bool enabled;
+} PWM_SLICE;
+
+static PWM_SLICE pwm_slices[NUM_PWM_SLICES];
+pwm_hw_t host_pwm_hw;
+
+unsigned int pwm_gpio_to_slice_num(unsigned int gpio)
+{
+    return (gpio >> 1) % NUM_PWM_SLICES;
+}
+
+void pwm_set_wrap(unsigned int slice_num, uint16_t wrap)
+{
+    pwm_slices[slice_num].wrap = wrap;
+}
+
+void pwm_set_chan_level(unsigned int slice_num, unsigned int chan, uint16_t level)
+{
+    pwm_slices[slice_num].level[chan] = level;
+}
+
+void pwm_set_clkdiv_int_frac(unsigned int slice_num, uint8_t integer, uint8_t fract)
+{
+    pwm_slices[slice_num].div_int = integer;
+    pwm_slices[slice_num].div_frac = fract;
+}
+
+void pwm_set_enabled(unsigned int slice_num, bool enabled)
+{
+    pwm_slices[slice_num].enabled = enabled;
+}
+
+unsigned int pwm_get_dreq(unsigned int slice_num)
+{
+    return DREQ_PWM_WRAP0 + slice_num;
+}
+
+static uint64_t pwm_wrap_ns(unsigned int slice_num)
+{
+    PWM_SLICE *s = &pwm_slices[slice_num];
+    uint32_t div = s->div_int * 16 + s->div_frac;
+
+    if (s->div_int == 0)
+        div += 256 * 16;
+    return (uint64_t)(s->wrap + 1) * div * 1000000000 / 16 / SYS_CLK_HZ;
+}
+
+/*
+ * Queue
+ */
+void queue_init(queue_t *q, unsigned int element_size, unsigned int element_count)
+{
+    q->data = calloc(element_count + 1, element_size);
+    q->element_size = element_size;
+    q->element_count = element_count;
+    q->wptr = q->rptr = 0;
+}
+
+unsigned int queue_get_level(queue_t *q)
+{
+    int level = q->wptr - q->rptr;
+
+    if (level < 0)
+        level += q->element_count + 1;
+    return level;
+}
+
+bool queue_try_add(queue_t *q, const void *data)
+{
+    if (queue_is_full(q))
+        return false;
+    memcpy(q->data + q->wptr * q->element_size, data, q->element_size);
+    if (++q->wptr > q->element_count)
+        q->wptr = 0;
+    return true;
+}
+
+bool queue_try_peek(queue_t *q, void *data)
+{
+    if (queue_is_empty(q))
+        return false;
+    memcpy(data, q->data + q->rptr * q->element_size, q->element_size);
+    return true;
+}
+
+bool queue_try_remove(queue_t *q, void *data)
+{
+    if (!queue_try_peek(q, data))
+        return false;
+    if (++q->rptr > q->element_count)
+        q->rptr = 0;
+    return true;
+}
+
+void queue_add_blocking(queue_t *q, const void *data)
+{
+    while (!queue_try_add(q, data))
+        host_advance_ns(1000000);
+}
+
+void queue_remove_blocking(queue_t *q, void *data)
+{
+    while (!queue_try_remove(q, data))
+        host_advance_ns(1000000);
+}
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug)
+{
+    printf("host: watchdog reboot requested\n");
+    exit(0);
+}
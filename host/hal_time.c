@@ -0,0 +1,226 @@
+/*
+ * Pico Games host build
+ *
+ * Virtual time, sleep, alarms and repeating timers.
+ */
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "hal.h"
+
+/* Time consumed by each poll of the clock or a busy flag */
+#define	POLL_STEP_NS	1000
+
+#define	MAX_ALARMS	16
+
+/* Stop anyway if the program does not sleep after stop request */
+#define	STOP_TIMEOUT_NS	1000000000ull
+
+typedef struct {
+    alarm_id_t id;
+    uint64_t when;
+    alarm_callback_t callback;
+    void *user_data;
+    repeating_timer_t *rt;
+} ALARM;
+
+static uint64_t now_ns;
+static ALARM alarms[MAX_ALARMS];
+static alarm_id_t next_id = 1;
+static int in_callback;
+static bool stop_requested;
+static uint64_t stop_deadline;
+
+uint64_t host_time_ns(void)
+{
+    return now_ns;
+}
+
+static ALARM *find_due(uint64_t t_ns)
+{
+    ALARM *due = NULL;
+
+    for (int i = 0; i < MAX_ALARMS; i++)
+    {
+        if (alarms[i].id && alarms[i].when <= t_ns && (due == NULL || alarms[i].when < due->when))
+            due = &alarms[i];
+    }
+    return due;
+}
+
+void host_advance_to(uint64_t t_ns)
+{
+    ALARM *ap;
+
+    /* Callbacks run like interrupt handlers, they never nest */
+    if (!in_callback)
+    {
+        while ((ap = find_due(t_ns)) != NULL)
+        {
+            ALARM a = *ap;
+
+            if (a.when > now_ns)
+                now_ns = a.when;
+            in_callback = 1;
+            if (a.rt)
+            {
+                if (a.rt->callback(a.rt) && ap->id == a.id)
+                    ap->when = a.when + (uint64_t)llabs(a.rt->delay_us) * 1000;
+                else if (ap->id == a.id)
+                    ap->id = 0;
+            }
+            else
+            {
+                int64_t r;
+
+                ap->id = 0;
+                r = a.callback(a.id, a.user_data);
+                if (r > 0)
+                {
+                    ap->id = a.id;
+                    ap->when = a.when + (uint64_t)r * 1000;
+                }
+                else if (r < 0)
+                {
+                    ap->id = a.id;
+                    ap->when = now_ns + (uint64_t)(-r) * 1000;
+                }
+            }
+            in_callback = 0;
+        }
+    }
+    if (t_ns > now_ns)
+        now_ns = t_ns;
+    if (stop_requested && now_ns >= stop_deadline && !in_callback)
+        host_stop();
+}
+
+void host_request_stop(void)
+{
+    stop_requested = true;
+    stop_deadline = now_ns + STOP_TIMEOUT_NS;
+}
+
+static void check_stop(void)
+{
+    if (stop_requested && !in_callback)
+        host_stop();
+}
+
+void host_advance_ns(uint64_t ns)
+{
+    host_advance_to(now_ns + ns);
+}
+
+absolute_time_t get_absolute_time(void)
+{
+    host_advance_ns(POLL_STEP_NS);
+    return now_ns / 1000;
+}
+
+uint64_t time_us_64(void)
+{
+    return get_absolute_time();
+}
+
+void sleep_us(uint64_t us)
+{
+    check_stop();
+    host_advance_ns(us * 1000);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    check_stop();
+    host_advance_ns((uint64_t)ms * 1000000);
+}
+
+void sleep_until(absolute_time_t t)
+{
+    check_stop();
+    host_advance_to(t * 1000);
+}
+
+void busy_wait_us(uint64_t us)
+{
+    check_stop();
+    host_advance_ns(us * 1000);
+}
+
+static ALARM *alloc_alarm(void)
+{
+    for (int i = 0; i < MAX_ALARMS; i++)
+    {
+        if (alarms[i].id == 0)
+        {
+            alarms[i].id = next_id++;
+            return &alarms[i];
+        }
+    }
+    fprintf(stderr, "host: too many alarms\n");
+    abort();
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+    ALARM *ap = alloc_alarm();
+
+    ap->when = now_ns + us * 1000;
+    ap->callback = callback;
+    ap->user_data = user_data;
+    ap->rt = NULL;
+    return ap->id;
+}
+
+void host_alarm_at_ns(uint64_t t_ns, alarm_callback_t callback, void *user_data)
+{
+    ALARM *ap = alloc_alarm();
+
+    ap->when = t_ns;
+    ap->callback = callback;
+    ap->user_data = user_data;
+    ap->rt = NULL;
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+    return add_alarm_in_us((uint64_t)ms * 1000, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+    for (int i = 0; i < MAX_ALARMS; i++)
+    {
+        if (alarm_id && alarms[i].id == alarm_id)
+        {
+            alarms[i].id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out)
+{
+    ALARM *ap = alloc_alarm();
+
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->alarm_id = ap->id;
+    ap->when = now_ns + (uint64_t)llabs(delay_us) * 1000;
+    ap->rt = out;
+    return true;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out)
+{
+    return add_repeating_timer_us((int64_t)delay_ms * 1000, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+    bool r = cancel_alarm(timer->alarm_id);
+
+    timer->alarm_id = 0;
+    return r;
+}
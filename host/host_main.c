@@ -0,0 +1,430 @@
+/*
+ * Pico Games host build
+ *
+ * Runs one game against the simulated LCD for given number of frames,
+ * then saves the screen as PPM and prints SPI statistics.
+ *
+ * usage: picogames_host [-g game] [-n frames] [-o file.ppm] [-r hz] [-H] [-D] [-k frame:keys]...
+ *   game:  invader, pacman, tetris, peg, hakomusu (and menu if built with lvgl)
+ *   keys:  up, down, left, right, start, fire joined by '+', or none
+ *   hz:    send keys as synthetic HID reports at this rate
+ *   -H:    run pacman headless, frames are stepped without drawing and
+ *          waiting, then the state checksum and speed are printed
+ *   -D:    draw a test scene directly and through display lists, and
+ *          compare the screen checksums
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "picogames.h"
+#include "hal.h"
+#include "latency.h"
+#include "pacman2.h"
+
+#define	FRAME_US	16667
+#define	MAX_KEYS	64
+#define	DL_CHECK_CMDS	1024	/* arena holding the whole test scene */
+#define	DL_CHECK_SMALL	7	/* arena replayed many times, also in compose */
+
+typedef struct {
+    const char *name;
+    void (*game)(void);
+} HOST_GAME;
+
+static void menu_main(void);
+
+static const HOST_GAME host_games[] = {
+    { "invader", inv_main },
+    { "pacman", pacman_main },
+    { "tetris", tetris_main },
+    { "peg", peg_main },
+    { "hakomusu", hakomusu_main },
+    { "menu", menu_main },
+};
+
+typedef struct {
+    uint32_t frame;
+    uint32_t mask;
+} HOST_KEY;
+
+static HOST_KEY host_keys[MAX_KEYS];
+static int num_keys;
+static uint32_t num_frames = 600;
+static const char *out_file;
+static uint32_t report_hz;
+static int headless;
+static uint32_t key_mask;
+static repeating_timer_t report_timer;
+
+static const struct {
+    const char *name;
+    uint32_t mask;
+} key_names[] = {
+    { "up", KEYUP },
+    { "down", KEYDOWN },
+    { "left", KEYLEFT },
+    { "right", KEYRIGHT },
+    { "start", KEYSTART },
+    { "fire", KEYFIRE },
+    { "none", 0 },
+};
+
+static int parse_key(const char *arg, HOST_KEY *kp)
+{
+    char buf[64];
+    char *tok, *next;
+
+    kp->frame = strtoul(arg, &next, 0);
+    if (*next != ':')
+        return -1;
+    snprintf(buf, sizeof(buf), "%s", next + 1);
+    kp->mask = 0;
+    for (tok = strtok(buf, "+"); tok; tok = strtok(NULL, "+"))
+    {
+        unsigned int i;
+
+        for (i = 0; i < sizeof(key_names)/sizeof(key_names[0]); i++)
+            if (strcmp(tok, key_names[i].name) == 0)
+                break;
+        if (i == sizeof(key_names)/sizeof(key_names[0]))
+            return -1;
+        kp->mask |= key_names[i].mask;
+    }
+    return 0;
+}
+
+/*
+ * Key input is posted as the Bluetooth side does.
+ */
+extern void host_post_keys(uint32_t mask);
+
+static int64_t key_callback(alarm_id_t id, void *user_data)
+{
+    HOST_KEY *kp = user_data;
+
+    if (report_hz)
+    {
+        key_mask = kp->mask;
+        return 0;
+    }
+    latency_report_received();
+    host_post_keys(kp->mask);
+    latency_add(LAT_DECODE, latency_report_stamp());
+    return 0;
+}
+
+/*
+ * Synthetic HID reports. Like a real controller, the state of keys is
+ * sent at fixed rate, so a key change waits for the next report.
+ * Drivers post keys only when they have changed.
+ */
+static bool report_callback(repeating_timer_t *rt)
+{
+    static uint32_t sent_mask;
+
+    latency_report_received();
+    if (key_mask != sent_mask)
+    {
+        host_post_keys(key_mask);
+        sent_mask = key_mask;
+    }
+    latency_add(LAT_DECODE, latency_report_stamp());
+    return true;
+}
+
+static void report(void)
+{
+    double sec = host_time_ns() / 1e9;
+    FRAMESTATS fs;
+
+    printf("frames %u, time %.3f s\n", num_frames, sec);
+    printf("spi: %llu bytes, %u transactions, %u dma, busy %.1f%%\n",
+           (unsigned long long)host_spi_stats.bytes, host_spi_stats.transactions,
+           host_spi_stats.dma_transfers, host_spi_stats.busy_ns / 1e7 / sec);
+    printf("lcd: %u commands, %u windows, %llu pixels, %u reads\n",
+           ili9341_stats.commands, ili9341_stats.windows,
+           (unsigned long long)ili9341_stats.pixels, ili9341_stats.reads);
+    printf("per frame: %.0f bytes, %.1f transactions, %.1f windows, %.0f us busy\n",
+           (double)host_spi_stats.bytes / num_frames,
+           (double)host_spi_stats.transactions / num_frames,
+           (double)ili9341_stats.windows / num_frames,
+           host_spi_stats.busy_ns / 1e3 / num_frames);
+    get_frame_stats(&fs);
+    if (fs.frames)
+        printf("frame: %u waits, %u overruns, %u dropped, work avg %.0f us max %u us, %.1f%% of budget, late max %u us\n",
+               fs.frames, fs.overruns, fs.dropped, (double)fs.work_total / fs.frames, fs.work_max,
+               fs.budget_total ? fs.work_total * 100.0 / fs.budget_total : 0.0, fs.late_max);
+    latency_print();
+    printf("checksum %08x\n", ili9341_model_checksum());
+    if (out_file)
+        ili9341_model_save_ppm(out_file);
+}
+
+void host_stop(void)
+{
+    report();
+    exit(0);
+}
+
+static int64_t end_callback(alarm_id_t id, void *user_data)
+{
+    host_request_stop();
+    return 0;
+}
+
+#ifdef HOST_MENU
+static void menu_main(void)
+{
+    extern int run_menu(int mode);
+
+    post_event(PAD_CONNECT, 0, NULL);
+    run_menu(0);
+}
+#else
+static void menu_main(void)
+{
+    fprintf(stderr, "menu is not built, lvgl submodule is missing\n");
+    exit(1);
+}
+#endif
+
+/*
+ * FNV-1a over the game state, fields are hashed one by one to skip
+ * structure padding.
+ */
+static uint32_t hash_bytes(uint32_t h, const void *p, size_t n)
+{
+    const uint8_t *b = p;
+
+    while (n--)
+        h = (h ^ *b++) * 16777619u;
+    return h;
+}
+
+static uint32_t hash_state(uint32_t h, const _GameState *st)
+{
+    h = hash_bytes(h, &st->score, sizeof(st->score));
+    h = hash_bytes(h, &st->stage, sizeof(st->stage));
+    h = hash_bytes(h, &st->player, sizeof(st->player));
+    h = hash_bytes(h, &st->cookie, sizeof(st->cookie));
+    h = hash_bytes(h, &st->gamestatus, sizeof(st->gamestatus));
+    for (int i = 0; i < 5; i++)
+    {
+        h = hash_bytes(h, &st->chars[i].x, sizeof(st->chars[i].x));
+        h = hash_bytes(h, &st->chars[i].y, sizeof(st->chars[i].y));
+        h = hash_bytes(h, &st->chars[i].dir, sizeof(st->chars[i].dir));
+        h = hash_bytes(h, &st->chars[i].status, sizeof(st->chars[i].status));
+    }
+    return h;
+}
+
+/*
+ * Step pacman for num_frames frames without LCD and frame waits. A key
+ * event holds its keys from its frame until the next one. A new game
+ * is started when the game is over.
+ */
+static void headless_run(void)
+{
+    _GameState st;
+    uint32_t mask = 0, h = 2166136261u, games = 1;
+    struct timespec t0, t1;
+    double sec;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pacman_reset(1);
+    for (uint32_t f = 0; f < num_frames; f++)
+    {
+        for (int i = 0; i < num_keys; i++)
+            if (host_keys[i].frame == f)
+                mask = host_keys[i].mask;
+        if (pacman_step(mask, &st) == 4)
+        {
+            pacman_reset(1);
+            games++;
+        }
+        h = hash_state(h, &st);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("frames %u, games %u, stage %u, score %u0\n", num_frames, games, st.stage, st.score);
+    printf("headless: %.3f s, %.0f frames/s\n", sec, sec > 0 ? num_frames / sec : 0.0);
+    printf("state checksum %08x\n", h);
+}
+
+/*
+ * Test scene for the display list check. Fills and fonts painted over
+ * by later ones, adjacent fills to be merged, and compose blocks.
+ */
+static void dl_scene(void)
+{
+    uint32_t r = 1;
+    int x, y;
+
+    clear_graphic();
+    for (int i = 0; i < 300; i++)
+    {
+        r = r * 1103515245u + 12345u;
+        x = (r >> 8) % (X_RES - 48);
+        y = (r >> 16) % (Y_RES - 48);
+        switch ((r >> 24) % 6)
+        {
+        case 0:
+            boxfill(x + 4, y + 4, x + 11, y + 11, r % 7 + 1);
+            boxfill(x, y, x + 15, y + 15, (r >> 3) % 15 + 1);
+            break;
+        case 1:
+            boxfill(x, y, x + 7, y + 7, 3);
+            boxfill(x + 8, y, x + 15, y + 7, 3);
+            boxfill(x, y + 8, x + 15, y + 15, 3);
+            break;
+        case 2:
+            clrbmpmn(x, y, 8, 8);
+            clrbmpmn(x + 8, y, 8, 8);
+            clrbmpmn(x, y + 8, 16, 8);
+            break;
+        case 3:
+            putfont(x, y, 7, 2, 'A' + i % 26);
+            putfont(x, y, 6, -1, '0' + i % 10);
+            putfont(x + 8, y, 5, 0, 'A' + i % 26);
+            break;
+        case 4:
+            putfont(x + 8, y + 8, 4, 1, 'X');
+            if (compose_begin(x, y, x + 31, y + 31))
+            {
+                boxfill(x + 2, y + 2, x + 20, y + 20, 5);
+                putfont(x + 8, y + 8, 7, -1, 'Y');
+                pset(x + 30, y + 30, 6);
+                compose_end();
+            }
+            break;
+        default:
+            hline(x, x + 40, y, 2);
+            pset(x, y + 1, 1);
+            break;
+        }
+    }
+    /* Longer than the small arena, so its last list starts in compose */
+    if (compose_begin(100, 100, 147, 147))
+    {
+        for (int i = 0; i < 16; i++)
+            putfont(100 + i % 6 * 8, 100 + i / 6 * 8, i % 7 + 1, 0, 'A' + i);
+        compose_end();
+    }
+}
+
+/*
+ * Draw the scene directly, then record it into display lists which are
+ * optimised and replayed. The screen is cleared before each replay, so
+ * a list which draws nothing does not pass.
+ */
+static int dl_check(void)
+{
+    extern const unsigned char TetrisFontData[];
+    static RENDER_CMD arena[DL_CHECK_CMDS];
+    static const int sizes[] = { DL_CHECK_CMDS, DL_CHECK_SMALL };
+    DISPLAYLIST dl;
+    uint32_t direct, listed;
+    int recorded, failed = 0;
+
+    board_init();
+    set_font_data(TetrisFontData);
+    init_graphic();
+    dl_scene();
+    flush_graphic();
+    direct = ili9341_model_checksum();
+    printf("direct: checksum %08x\n", direct);
+    for (int i = 0; i < 2; i++)
+    {
+        clear_graphic();
+        flush_graphic();
+        dl_init(&dl, arena, sizes[i]);
+        dl_begin(&dl);
+        dl_scene();
+        dl_end();
+        recorded = dl.count;
+        dl_optimize(&dl);
+        dl_replay(&dl);
+        flush_graphic();
+        listed = ili9341_model_checksum();
+        printf("arena %d: last list %d -> %d commands, checksum %08x %s\n",
+               sizes[i], recorded, dl.count, listed, listed == direct ? "ok" : "DIFFERENT");
+        if (listed != direct)
+            failed = 1;
+    }
+    return failed;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: picogames_host [-g game] [-n frames] [-o file.ppm] [-r hz] [-H] [-D] [-k frame:keys]...\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const HOST_GAME *gp = &host_games[0];
+    int c;
+
+    while ((c = getopt(argc, argv, "g:n:o:r:k:HD")) != -1)
+    {
+        switch (c)
+        {
+        case 'g':
+            for (gp = host_games; gp < host_games + sizeof(host_games)/sizeof(host_games[0]); gp++)
+                if (strcmp(gp->name, optarg) == 0)
+                    break;
+            if (gp == host_games + sizeof(host_games)/sizeof(host_games[0]))
+                usage();
+            break;
+        case 'n':
+            num_frames = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            out_file = optarg;
+            break;
+        case 'r':
+            report_hz = strtoul(optarg, NULL, 0);
+            if (report_hz == 0 || report_hz > 1000000)
+                usage();
+            break;
+        case 'k':
+            if (num_keys >= MAX_KEYS || parse_key(optarg, &host_keys[num_keys]) < 0)
+                usage();
+            num_keys++;
+            break;
+        case 'H':
+            headless = 1;
+            break;
+        case 'D':
+            return dl_check();
+        default:
+            usage();
+        }
+    }
+    if (num_frames == 0)
+        usage();
+    if (headless)
+    {
+        if (gp->game != pacman_main)
+            usage();
+        headless_run();
+        return 0;
+    }
+
+    padevent_init();
+    board_init();
+
+    for (int i = 0; i < num_keys; i++)
+        add_alarm_in_us((uint64_t)host_keys[i].frame * FRAME_US, key_callback, &host_keys[i], true);
+    add_alarm_in_us((uint64_t)num_frames * FRAME_US, end_callback, NULL, true);
+    if (report_hz)
+        add_repeating_timer_us(-(int64_t)(1000000 / report_hz), report_callback, NULL, &report_timer);
+
+    (*gp->game)();
+
+    /* Game returned before the end of run */
+    report();
+    return 0;
+}
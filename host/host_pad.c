@@ -0,0 +1,68 @@
+/*
+ * Pico Games host build
+ *
+ * Stand-ins for Bluetooth side functions. Keys from command line are
+ * posted as virtual button mask in game mode, or as LVGL key events
+ * while the menu is running.
+ */
+#include "pico/stdlib.h"
+#include "picogames.h"
+#include "btapi.h"
+
+static uint8_t hid_mode = HID_MODE_LVGL;
+static uint32_t old_mask;
+
+void set_hid_mode(uint8_t mode)
+{
+  hid_mode = mode;
+}
+
+void post_btreq(BBEVENT code)
+{
+}
+
+uint16_t get_btstack_state()
+{
+  return BT_STATE_HID_CONNECT;
+}
+
+#ifdef HOST_MENU
+static const PADKEY_DATA host_key_table[] = {
+  { VBMASK_UP,     LV_KEY_PREV },
+  { VBMASK_LEFT,   LV_KEY_PREV },
+  { VBMASK_DOWN,   LV_KEY_NEXT },
+  { VBMASK_RIGHT,  LV_KEY_NEXT },
+  { VBMASK_CIRCLE, LV_KEY_ENTER },
+  { VBMASK_SQUARE, LV_KEY_ENTER },
+  { 0, 0 },
+};
+
+void xpt2046_read(lv_indev_t *indev_drv, lv_indev_data_t *data)
+{
+  data->state = LV_INDEV_STATE_RELEASED;
+}
+
+void wsdemo_main()
+{
+}
+#endif
+
+void host_post_keys(uint32_t mask)
+{
+#ifdef HOST_MENU
+  if (hid_mode == HID_MODE_LVGL)
+  {
+    const PADKEY_DATA *kp;
+
+    for (kp = host_key_table; kp->mask; kp++)
+    {
+      if ((mask ^ old_mask) & kp->mask)
+        post_event((mask & kp->mask) ? PAD_KEY_PRESS : PAD_KEY_RELEASE, kp->lvkey, NULL);
+    }
+    old_mask = mask;
+    return;
+  }
+#endif
+  post_vkeymask(mask);
+  old_mask = mask;
+}
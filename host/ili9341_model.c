@@ -0,0 +1,233 @@
+/*
+ * Pico Games host build
+ *
+ * ILI9341 panel model. Decodes the command stream into a 240x320 RGB565
+ * frame memory. Supported commands are column/page address set (2Ah/2Bh),
+ * memory write/continue (2Ch/3Ch), memory read (2Eh), memory access
+ * control (36h) and vertical scrolling (33h/37h). Others are ignored.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+
+#define	PANEL_W	240
+#define	PANEL_H	320
+
+ILI9341_STATS ili9341_stats;
+
+static uint16_t gram[PANEL_H][PANEL_W];
+static uint8_t cmd;
+static int nparam;
+static uint8_t param[8];
+static uint16_t xs, xe = PANEL_W - 1, ys, ye = PANEL_H - 1;
+static uint16_t cx, cy;
+static uint8_t madctl;
+static uint16_t tfa, vsa = PANEL_H, bfa, vsp;
+static bool pixel_half;
+static uint8_t pixel_hi;
+static int read_pos;
+
+/* Map logical address to frame memory following MX/MY of MADCTL */
+static uint16_t *gram_at(int x, int y)
+{
+    if (x >= PANEL_W || y >= PANEL_H)
+        return NULL;
+    /* MX=1 is the normal orientation of this module */
+    if (!(madctl & 0x40))
+        x = PANEL_W - 1 - x;
+    if (madctl & 0x80)
+        y = PANEL_H - 1 - y;
+    return &gram[y][x];
+}
+
+static void advance_cursor(void)
+{
+    if (++cx > xe)
+    {
+        cx = xs;
+        if (++cy > ye)
+            cy = ys;
+    }
+}
+
+static void write_command(uint8_t c)
+{
+    cmd = c;
+    nparam = 0;
+    pixel_half = false;
+    ili9341_stats.commands++;
+    switch (c)
+    {
+    case 0x2c:
+        cx = xs;
+        cy = ys;
+        break;
+    case 0x2e:
+        cx = xs;
+        cy = ys;
+        read_pos = 0;
+        ili9341_stats.reads++;
+        break;
+    case 0x2a:
+        ili9341_stats.windows++;
+        break;
+    default:
+        break;
+    }
+}
+
+static void write_pixel(uint16_t color)
+{
+    uint16_t *p = gram_at(cx, cy);
+
+    if (p)
+        *p = color;
+    ili9341_stats.pixels++;
+    advance_cursor();
+}
+
+static void write_param(uint8_t d)
+{
+    if (cmd == 0x2c || cmd == 0x3c)
+    {
+        if (!pixel_half)
+        {
+            pixel_hi = d;
+            pixel_half = true;
+        }
+        else
+        {
+            pixel_half = false;
+            write_pixel((pixel_hi << 8) | d);
+        }
+        return;
+    }
+    if (nparam < (int)sizeof(param))
+        param[nparam] = d;
+    nparam++;
+    switch (cmd)
+    {
+    case 0x2a:
+        if (nparam == 2)
+            xs = (param[0] << 8) | param[1];
+        else if (nparam == 4)
+            xe = (param[2] << 8) | param[3];
+        break;
+    case 0x2b:
+        if (nparam == 2)
+            ys = (param[0] << 8) | param[1];
+        else if (nparam == 4)
+            ye = (param[2] << 8) | param[3];
+        break;
+    case 0x36:
+        if (nparam == 1)
+            madctl = d;
+        break;
+    case 0x33:
+        if (nparam == 6)
+        {
+            tfa = (param[0] << 8) | param[1];
+            vsa = (param[2] << 8) | param[3];
+            bfa = (param[4] << 8) | param[5];
+        }
+        break;
+    case 0x37:
+        if (nparam == 2)
+            vsp = (param[0] << 8) | param[1];
+        break;
+    default:
+        break;
+    }
+}
+
+void ili9341_model_write(uint8_t data, bool dc)
+{
+    if (dc)
+        write_param(data);
+    else
+        write_command(data);
+}
+
+uint8_t ili9341_model_read(void)
+{
+    uint16_t *p;
+    uint16_t c;
+    int n;
+
+    if (cmd != 0x2e)
+        return 0;
+    /* First byte is dummy, then R, G, B for each pixel */
+    n = read_pos++;
+    if (n == 0)
+        return 0;
+    n--;
+    p = gram_at(cx, cy);
+    c = p ? *p : 0;
+    switch (n % 3)
+    {
+    case 0:
+        return (c >> 8) & 0xf8;
+    case 1:
+        return (c >> 3) & 0xfc;
+    default:
+        advance_cursor();
+        return (c << 3) & 0xf8;
+    }
+}
+
+/*
+ * Pixel on the screen, with vertical scroll applied.
+ */
+uint16_t ili9341_model_get_pixel(int x, int y)
+{
+    if (y >= tfa && y < tfa + vsa && vsa > 0)
+        y = tfa + ((vsp - tfa) + (y - tfa)) % vsa;
+    return gram[y % PANEL_H][x];
+}
+
+int ili9341_model_save_ppm(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+
+    if (fp == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", PANEL_W, PANEL_H);
+    for (int y = 0; y < PANEL_H; y++)
+    {
+        for (int x = 0; x < PANEL_W; x++)
+        {
+            uint16_t c = ili9341_model_get_pixel(x, y);
+            uint8_t rgb[3];
+
+            rgb[0] = ((c >> 11) << 3) | (c >> 13);
+            rgb[1] = (((c >> 5) & 0x3f) << 2) | ((c >> 9) & 3);
+            rgb[2] = ((c & 0x1f) << 3) | ((c >> 2) & 7);
+            fwrite(rgb, 1, 3, fp);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+/*
+ * FNV-1a hash of the screen, to compare output between runs.
+ */
+uint32_t ili9341_model_checksum(void)
+{
+    uint32_t h = 2166136261u;
+
+    for (int y = 0; y < PANEL_H; y++)
+    {
+        for (int x = 0; x < PANEL_W; x++)
+        {
+            uint16_t c = ili9341_model_get_pixel(x, y);
+
+            h = (h ^ (c & 0xff)) * 16777619u;
+            h = (h ^ (c >> 8)) * 16777619u;
+        }
+    }
+    return h;
+}
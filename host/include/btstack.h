@@ -0,0 +1,14 @@
+/*
+ * Host build replacement of btstack.h
+ * Only the types needed by btapi.h and the macro used by menu.c.
+ */
+#ifndef _HOST_BTSTACK_H
+#define _HOST_BTSTACK_H
+
+#include <stdint.h>
+
+typedef uint8_t bd_addr_t[6];
+
+#define UNUSED(x) (void)(x)
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * Host build replacement of hardware/dma.h
+ *
+ * A triggered channel moves all its data at once, but stays busy for
+ * the time the paced peripheral needs to take it. The chained channel
+ * is triggered when it is done.
+ */
+#ifndef _HOST_HARDWARE_DMA_H
+#define _HOST_HARDWARE_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NUM_DMA_CHANNELS 16
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct {
+    uint8_t size;
+    bool read_increment;
+    bool write_increment;
+    bool ring_write;
+    uint8_t ring_size_bits;
+    uint8_t dreq;
+    uint8_t chain_to;
+    bool irq_quiet;
+    bool enable;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(unsigned int channel);
+dma_channel_config dma_channel_get_default_config(unsigned int channel);
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { c->size = size; }
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) { c->read_increment = incr; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->write_increment = incr; }
+static inline void channel_config_set_dreq(dma_channel_config *c, unsigned int dreq) { c->dreq = dreq; }
+static inline void channel_config_set_chain_to(dma_channel_config *c, unsigned int chain_to) { c->chain_to = chain_to; }
+static inline void channel_config_set_irq_quiet(dma_channel_config *c, bool quiet) { c->irq_quiet = quiet; }
+static inline void channel_config_set_enable(dma_channel_config *c, bool enable) { c->enable = enable; }
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, unsigned int size_bits)
+{
+    c->ring_write = write;
+    c->ring_size_bits = size_bits;
+}
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, unsigned int transfer_count, bool trigger);
+void dma_channel_start(unsigned int channel);
+void dma_channel_set_read_addr(unsigned int channel, const volatile void *read_addr, bool trigger);
+bool dma_channel_is_busy(unsigned int channel);
+void dma_channel_wait_for_finish_blocking(unsigned int channel);
+
+/* DMA_IRQ_0 is raised when a channel enabled for it finishes */
+void dma_channel_set_irq0_enabled(unsigned int channel, bool enabled);
+bool dma_channel_get_irq0_status(unsigned int channel);
+void dma_channel_acknowledge_irq0(unsigned int channel);
+
+#endif
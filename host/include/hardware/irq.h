@@ -0,0 +1,28 @@
+/*
+ * Host build replacement of hardware/irq.h
+ *
+ * Interrupt handlers are called from alarm processing of the virtual
+ * clock, so like other callbacks they never nest.
+ */
+#ifndef _HOST_HARDWARE_IRQ_H
+#define _HOST_HARDWARE_IRQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DMA_IRQ_0 10
+#define DMA_IRQ_1 11
+#define NUM_IRQS 64
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler);
+void irq_add_shared_handler(unsigned int num, irq_handler_t handler, uint8_t order_priority);
+void irq_set_enabled(unsigned int num, bool enabled);
+
+/* Call handlers of an enabled interrupt, used by the peripheral models */
+void host_raise_irq(unsigned int num);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Host build replacement of hardware/pwm.h
+ */
+#ifndef _HOST_HARDWARE_PWM_H
+#define _HOST_HARDWARE_PWM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum { PWM_CHAN_A = 0, PWM_CHAN_B = 1 };
+
+#define NUM_PWM_SLICES 12
+
+/* Registers written by DMA, the model reads the level from cc */
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t div;
+    volatile uint32_t ctr;
+    volatile uint32_t cc;
+    volatile uint32_t top;
+} pwm_slice_hw_t;
+
+typedef struct {
+    pwm_slice_hw_t slice[NUM_PWM_SLICES];
+} pwm_hw_t;
+
+extern pwm_hw_t host_pwm_hw;
+#define pwm_hw (&host_pwm_hw)
+
+unsigned int pwm_gpio_to_slice_num(unsigned int gpio);
+void pwm_set_wrap(unsigned int slice_num, uint16_t wrap);
+void pwm_set_chan_level(unsigned int slice_num, unsigned int chan, uint16_t level);
+void pwm_set_clkdiv_int_frac(unsigned int slice_num, uint8_t integer, uint8_t fract);
+void pwm_set_enabled(unsigned int slice_num, bool enabled);
+unsigned int pwm_get_dreq(unsigned int slice_num);
+
+#endif
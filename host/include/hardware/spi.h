@@ -0,0 +1,58 @@
+/*
+ * Host build replacement of hardware/spi.h
+ *
+ * Bytes sent to the LCD SPI instance go to the ILI9341 panel model,
+ * taking the transfer time at the configured baud rate.
+ */
+#ifndef _HOST_HARDWARE_SPI_H
+#define _HOST_HARDWARE_SPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+    volatile uint32_t cr0;
+    volatile uint32_t cr1;
+    volatile uint32_t dr;
+    volatile uint32_t sr;
+    volatile uint32_t cpsr;
+    volatile uint32_t imsc;
+    volatile uint32_t ris;
+    volatile uint32_t mis;
+    volatile uint32_t icr;
+    volatile uint32_t dmacr;
+} spi_hw_t;
+
+typedef struct spi_inst {
+    spi_hw_t hw;
+    unsigned int baudrate;
+    unsigned int data_bits;
+    uint64_t busy_until;
+} spi_inst_t;
+
+extern spi_inst_t host_spi[2];
+
+#define spi0 (&host_spi[0])
+#define spi1 (&host_spi[1])
+
+typedef enum { SPI_CPHA_0 = 0, SPI_CPHA_1 = 1 } spi_cpha_t;
+typedef enum { SPI_CPOL_0 = 0, SPI_CPOL_1 = 1 } spi_cpol_t;
+typedef enum { SPI_LSB_FIRST = 0, SPI_MSB_FIRST = 1 } spi_order_t;
+
+#define SPI_SSPICR_RORIC_BITS 0x00000001
+
+unsigned int spi_init(spi_inst_t *spi, unsigned int baudrate);
+void spi_set_format(spi_inst_t *spi, unsigned int data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+unsigned int spi_get_index(const spi_inst_t *spi);
+unsigned int spi_get_dreq(spi_inst_t *spi, bool is_tx);
+bool spi_is_busy(const spi_inst_t *spi);
+bool spi_is_readable(const spi_inst_t *spi);
+bool spi_is_writable(const spi_inst_t *spi);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_write16_blocking(spi_inst_t *spi, const uint16_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * Host build replacement of hardware/watchdog.h
+ * Reboot by watchdog ends the host program.
+ */
+#ifndef _HOST_HARDWARE_WATCHDOG_H
+#define _HOST_HARDWARE_WATCHDOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+
+#endif
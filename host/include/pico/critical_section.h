@@ -0,0 +1,15 @@
+/*
+ * Host build replacement of pico/critical_section.h
+ */
+#ifndef _HOST_PICO_CRITICAL_SECTION_H
+#define _HOST_PICO_CRITICAL_SECTION_H
+
+typedef struct {
+    int depth;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *crit_sec) { crit_sec->depth = 0; }
+static inline void critical_section_enter_blocking(critical_section_t *crit_sec) { crit_sec->depth++; }
+static inline void critical_section_exit(critical_section_t *crit_sec) { crit_sec->depth--; }
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Host build replacement of pico/mutex.h
+ * Games run in a single thread on host, so mutexes only check nesting.
+ */
+#ifndef _HOST_PICO_MUTEX_H
+#define _HOST_PICO_MUTEX_H
+
+#include <assert.h>
+#include <stdbool.h>
+
+typedef struct {
+    bool owned;
+} mutex_t;
+
+static inline void mutex_init(mutex_t *mtx) { mtx->owned = false; }
+static inline void mutex_enter_blocking(mutex_t *mtx) { assert(!mtx->owned); mtx->owned = true; }
+static inline void mutex_exit(mutex_t *mtx) { mtx->owned = false; }
+
+#endif
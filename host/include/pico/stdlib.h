@@ -0,0 +1,32 @@
+/*
+ * Host build replacement of pico SDK headers.
+ * Only what picogames uses is provided.
+ */
+#ifndef _HOST_PICO_STDLIB_H
+#define _HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+#define SYS_CLK_HZ 150000000
+
+#define tight_loop_contents() ((void)0)
+
+/* Host build runs everything on one core */
+static inline uint get_core_num(void) { return 0; }
+
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#define PICO_ERROR_TIMEOUT (-1)
+
+static inline bool stdio_init_all(void) { return true; }
+
+/* No serial input in host build */
+static inline int getchar_timeout_us(uint32_t timeout_us) { (void)timeout_us; return PICO_ERROR_TIMEOUT; }
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * Host build replacement of pico/util/queue.h
+ */
+#ifndef _HOST_PICO_UTIL_QUEUE_H
+#define _HOST_PICO_UTIL_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/mutex.h"
+
+typedef struct {
+    uint8_t *data;
+    uint16_t wptr;
+    uint16_t rptr;
+    uint16_t element_size;
+    uint16_t element_count;
+} queue_t;
+
+void queue_init(queue_t *q, unsigned int element_size, unsigned int element_count);
+unsigned int queue_get_level(queue_t *q);
+static inline bool queue_is_empty(queue_t *q) { return queue_get_level(q) == 0; }
+static inline bool queue_is_full(queue_t *q) { return queue_get_level(q) == q->element_count; }
+bool queue_try_add(queue_t *q, const void *data);
+bool queue_try_remove(queue_t *q, void *data);
+bool queue_try_peek(queue_t *q, void *data);
+void queue_add_blocking(queue_t *q, const void *data);
+void queue_remove_blocking(queue_t *q, void *data);
+
+#endif
@@ -0,0 +1,12 @@
+/*
+ * Used by host build when lvgl submodule is not checked out.
+ * gamepad.h needs only lv_key_t, menu is not built in this case.
+ */
+#ifndef _HOST_NOLVGL_H
+#define _HOST_NOLVGL_H
+
+#include <stdint.h>
+
+typedef uint32_t lv_key_t;
+
+#endif
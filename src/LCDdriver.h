@@ -12,7 +12,29 @@
 	#define Y_RES 240 // 縦方向解像度
 #endif
 
+#ifdef LCD_STATS
+// LCDアクセス統計（LCD_STATS指定時のみ）
+typedef struct {
+	unsigned int frames;    // フレーム数
+	unsigned int commands;  // コマンドバイト数
+	unsigned int windows;   // アドレスウィンドウ設定回数
+	unsigned int databytes; // データバイト数
+	unsigned int cstoggles; // CSアサート回数
+	unsigned int blockedus; // SPI転送完了待ち時間(us)
+} LCDSTATS;
+
+extern LCDSTATS lcd_stats; // 現在のフレームの集計
+#define LCD_STATS_ADD(f,n) (lcd_stats.f+=(n))
+void LCD_StatsFrame(void);
+void LCD_GetStats(LCDSTATS *last,LCDSTATS *total);
+void LCD_ResetStats(void);
+#else
+#define LCD_STATS_ADD(f,n) ((void)0)
+#define LCD_StatsFrame() ((void)0)
+#endif
+
 static inline void lcd_cs_lo() {
+    LCD_STATS_ADD(cstoggles,1);
     asm volatile("nop \n nop \n nop");
     gpio_put(LCD_CS, 0);
     asm volatile("nop \n nop \n nop");
@@ -43,6 +65,12 @@ void LCD_WriteData3(unsigned char *cmd, int cmd_size, unsigned char *param, int
 void LCD_WriteDataN(unsigned char *b,int n);
 void LCD_Init(void);
 void LCD_SetCursor(unsigned short x, unsigned short y);
+void LCD_setAddrWindow(unsigned short x,unsigned short y,unsigned short w,unsigned short h);
+void LCD_continuous_output(unsigned short x,unsigned short y,unsigned short color,int n);
 void LCD_Clear(unsigned short color);
+void LCD_FillRect(unsigned short x,unsigned short y,unsigned short w,unsigned short h,unsigned short color);
+void LCD_WriteRect(unsigned short x,unsigned short y,unsigned short w,unsigned short h,const unsigned short *b);
+void LCD_WriteRectDMA(unsigned short x,unsigned short y,unsigned short w,unsigned short h,const unsigned short *b);
+void LCD_WaitIdle(void);
 void drawPixel(unsigned short x, unsigned short y, unsigned short color);
 unsigned short getColor(unsigned short x, unsigned short y);
@@ -110,6 +110,37 @@ static void process_accel(struct dualsense_input_report *rp)
   }
 }
 
+/*
+ * Publish state of the report to the game core
+ */
+static void publish_inputs(struct dualsense_input_report *rp, uint32_t vbutton)
+{
+  struct gamepad_inputs in;
+  int i;
+
+  in.x = rp->x;
+  in.y = rp->y;
+  in.rx = rp->rx;
+  in.ry = rp->ry;
+  in.z = rp->z;
+  in.rz = rp->rz;
+  in.vbutton = vbutton;
+  for (i = 0; i < 3; i++)
+  {
+    in.gyro[i] = le16_to_cpu(rp->gyro[i]);
+    in.accel[i] = le16_to_cpu(rp->accel[i]);
+  }
+  for (i = 0; i < 2; i++)
+  {
+    in.points[i].contact = rp->points[i].contact;
+    in.points[i].xpos = (rp->points[i].x_hi << 8) | rp->points[i].x_lo;
+    in.points[i].ypos = (rp->points[i].y_hi << 4) | rp->points[i].y_lo;
+  }
+  in.Temperature = rp->Temperature;
+  in.battery_level = rp->battery_level & 0x0F;
+  publish_pad_inputs(&in);
+}
+
 /*
  * Decode DualSense Input report
  */
@@ -126,6 +157,7 @@ static void decode_report(HID_REPORT *report, struct dualsense_input_report *rp)
   vbutton |= hatmap[hat];
 
   DualSense_PadKey_Events(report->hid_mode, rp, hat, vbutton);
+  publish_inputs(rp, vbutton);
 
   if (rp->battery_level != prev_blevel)
   {
@@ -97,6 +97,33 @@ static void process_accel(struct ds4_input_report *rp)
   }
 }
 
+/*
+ * Publish state of the report to the game core
+ */
+static void publish_inputs(struct ds4_input_report *rp, uint32_t vbutton)
+{
+  struct gamepad_inputs in;
+  int i;
+
+  memset(&in, 0, sizeof(in));
+  in.x = rp->x;
+  in.y = rp->y;
+  in.rx = rp->rx;
+  in.ry = rp->ry;
+  in.z = rp->z;
+  in.rz = rp->rz;
+  in.vbutton = vbutton;
+  for (i = 0; i < 3; i++)
+  {
+    in.gyro[i] = le16_to_cpu(rp->gyro[i]);
+    in.accel[i] = le16_to_cpu(rp->accel[i]);
+  }
+  in.points[0].contact = in.points[1].contact = 0x80;	/* No touch */
+  in.Temperature = rp->temp;
+  in.battery_level = rp->status[0] & 0x0F;
+  publish_pad_inputs(&in);
+}
+
 /*
  * Decode DualShock Input report
  */
@@ -137,6 +164,7 @@ static void DualShockDecodeInputReport(HID_REPORT *report)
     vbutton |= hatmap[hat];
 
     DS4_PadKey_Events(report->hid_mode, rp, hat, vbutton, report);
+    publish_inputs(rp, vbutton);
   }
 
   if ((rp->status[0] & 0x0F) != prev_blevel)
@@ -0,0 +1,36 @@
+/*
+ * Pico Games
+ *
+ * Fixed point numbers for sub-dot motion, 8 bits below the point.
+ * RP2040 has no FPU, so positions and speeds are kept in 1/256 dots.
+ * The macros are constant expressions and can be used in initializers
+ * of speed tables.
+ *
+ * A speed is the distance moved in a frame. Added to a position every
+ * frame, the fraction below the point carries over, so a speed of 1.5
+ * moves 1 and 2 dots in turn.
+ */
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+#include <stdint.h>
+
+#define	FIX_SHIFT	8
+#define	FIX_ONE		(1 << FIX_SHIFT)
+
+typedef uint16_t UFIX8;		/* unsigned 8.8, wraps at 256 dots */
+typedef int32_t FIX8;		/* signed 24.8 */
+
+/* n dots */
+#define	FIX(n)		((n) * FIX_ONE)
+/* num dots in den frames, as a speed */
+#define	FIX_RATIO(num, den)	((num) * FIX_ONE / (den))
+/* Whole dots, truncated toward 0 as integer division */
+#define	FIX_INT(f)	((f) / FIX_ONE)
+
+static inline FIX8 fix_clamp(FIX8 v, FIX8 lo, FIX8 hi)
+{
+  return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ * Pico Games
+ *
+ * Game core side services, gamepad event queue and frame scheduler.
+ * Kept apart from main.c so that host build can share them.
+ */
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+#include "btapi.h"
+#include "picogames.h"
+#include "latency.h"
+
+/*
+ * Pad events are posted only by BTstack (or APDS) on core0 and read only
+ * by the game on core1, so a single producer / single consumer ring is
+ * enough and neither side takes a lock. Producer writes only the head,
+ * consumer writes only the tail.
+ *
+ * Latest gamepad state is kept apart in a snapshot. Core0 is the only
+ * writer and updates it under a sequence counter, which is odd while an
+ * update is in progress. Core1 copies it and retries if the counter has
+ * changed meanwhile, so the writer never waits. Button edges are kept as
+ * toggle bits flipped on each press or release, and the reader compares
+ * them with the values seen at its previous read. So a tap shorter than
+ * the game's polling interval is still seen once. Button changes are
+ * also counted, and the reader counts the ones it has not seen as
+ * coalesced.
+ *
+ * With PADEVENT_COALESCE, get_pad_vmask() reads buttons from the snapshot
+ * and PAD_KEY_VBMASK events do not go through the ring, so mask reports
+ * can never overflow the ring or be delayed behind older masks.
+ */
+#ifndef PADEVENT_DEPTH
+#define PADEVENT_DEPTH 16
+#endif
+#ifndef PADEVENT_COALESCE
+#define PADEVENT_COALESCE 1
+#endif
+
+#if PADEVENT_DEPTH & (PADEVENT_DEPTH - 1)
+#error PADEVENT_DEPTH must be power of 2
+#endif
+
+static PADEVENT padevent_ring[PADEVENT_DEPTH];
+static volatile uint32_t padevent_head;	/* written by producer */
+static volatile uint32_t padevent_tail;	/* written by consumer */
+
+static struct {
+  struct gamepad_inputs in;
+  uint32_t press_toggle;
+  uint32_t release_toggle;
+  uint32_t changes;		/* button changes published */
+  uint32_t stamp;
+} pad_shared;
+static volatile uint32_t pad_seq;	/* written by producer */
+static uint32_t press_seen, release_seen, changes_seen;	/* at previous read */
+static uint32_t pad_coalesced;	/* written by consumer */
+
+static PADEVENT_STATS padevent_stats;
+
+void padevent_init()
+{
+  padevent_head = padevent_tail = 0;
+}
+
+static void padevent_put(PADEVENT *event)
+{
+  uint32_t head = padevent_head;
+
+  padevent_stats.posted++;
+  if (head - padevent_tail >= PADEVENT_DEPTH)
+  {
+    padevent_stats.dropped++;
+    return;
+  }
+  padevent_ring[head & (PADEVENT_DEPTH - 1)] = *event;
+  if (head - padevent_tail + 1 > padevent_stats.maxlevel)
+    padevent_stats.maxlevel = head - padevent_tail + 1;
+  __mem_fence_release();
+  padevent_head = head + 1;
+}
+
+static bool padevent_get(PADEVENT *event)
+{
+  uint32_t tail = padevent_tail;
+
+  if (padevent_head == tail)
+    return false;
+  __mem_fence_acquire();
+  *event = padevent_ring[tail & (PADEVENT_DEPTH - 1)];
+  __mem_fence_release();
+  padevent_tail = tail + 1;
+  return true;
+}
+
+static uint32_t pad_write_begin()
+{
+  uint32_t seq = pad_seq + 1;
+
+  pad_seq = seq;
+  __dmb();
+  return seq;
+}
+
+static void pad_write_end(uint32_t seq)
+{
+  __dmb();
+  pad_seq = seq + 1;
+}
+
+static void pad_set_buttons(uint32_t vbutton)
+{
+  uint32_t old = pad_shared.in.vbutton;
+
+  if (vbutton == old)
+    return;
+  pad_shared.changes++;
+  pad_shared.press_toggle ^= vbutton & ~old;
+  pad_shared.release_toggle ^= old & ~vbutton;
+  pad_shared.in.vbutton = vbutton;
+  pad_shared.stamp = latency_report_stamp();
+  latency_add(LAT_ENQUEUE, pad_shared.stamp);
+}
+
+/*
+ * Called by HID decoders on core0 with the state of each input report.
+ */
+void publish_pad_inputs(const struct gamepad_inputs *in)
+{
+  uint32_t seq = pad_write_begin();
+
+  pad_set_buttons(in->vbutton);
+  pad_shared.in = *in;
+  pad_write_end(seq);
+}
+
+/*
+ * Copy latest gamepad state. pressed and released hold buttons which
+ * changed since the previous call.
+ */
+void read_pad_state(PADSTATE *st)
+{
+  uint32_t seq, press, release, changes, stamp;
+
+  do
+  {
+    seq = pad_seq;
+    __dmb();
+    st->in = pad_shared.in;
+    press = pad_shared.press_toggle;
+    release = pad_shared.release_toggle;
+    changes = pad_shared.changes;
+    stamp = pad_shared.stamp;
+    __dmb();
+  } while ((seq & 1) || seq != pad_seq);
+
+  st->pressed = press ^ press_seen;
+  st->released = release ^ release_seen;
+  st->stamp = stamp;
+  press_seen = press;
+  release_seen = release;
+  if (changes - changes_seen > 1)
+    pad_coalesced += changes - changes_seen - 1;	/* overwritten before read */
+  changes_seen = changes;
+}
+
+/*
+ * Forget button changes made so far, called when a game takes over the
+ * gamepad from the menu. Otherwise buttons pressed in the menu would be
+ * reported as pressed by the first read of the game.
+ */
+void pad_state_sync()
+{
+  PADSTATE st;
+  uint32_t coalesced = pad_coalesced;
+
+  read_pad_state(&st);
+  pad_coalesced = coalesced;	/* changes in the menu were not lost */
+}
+
+static void post_mask(uint32_t mask)
+{
+  uint32_t seq = pad_write_begin();
+
+  pad_set_buttons(mask);
+  pad_write_end(seq);
+#if PADEVENT_COALESCE
+  padevent_stats.posted++;
+#else
+  PADEVENT event;
+
+  event.type = PAD_KEY_VBMASK;
+  event.key_code = 0;
+  event.vmask = mask;
+  event.ptr = NULL;
+  padevent_put(&event);
+#endif
+}
+
+void get_padevent_stats(PADEVENT_STATS *stats)
+{
+  *stats = padevent_stats;
+  stats->coalesced = pad_coalesced;
+}
+
+void post_event(uint16_t type, uint16_t code, void *ptr)
+{
+  PADEVENT event;
+
+  event.type = type;
+  event.key_code = code;
+  event.vmask = 0;
+  event.ptr = ptr;
+  padevent_put(&event);
+}
+
+void post_padevent(PADKEY_EVENT *padevent)
+{
+  PADEVENT event;
+
+  if (padevent->type == PAD_KEY_VBMASK)
+  {
+    post_mask(padevent->vmask);
+    return;
+  }
+  event.type = padevent->type;
+  event.key_code = padevent->lvkey;
+  event.vmask = 0;
+  event.ptr = NULL;
+  padevent_put(&event);
+}
+
+void post_vkeymask(uint32_t mask)
+{
+  post_mask(mask);
+}
+
+static PADEVENT pevent;
+
+int check_pad_connect()
+{
+  if (!padevent_get(&pevent))
+    return 0;
+  if (pevent.type == PAD_CONNECT)
+    return 1;
+  return 0;
+}
+
+PADEVENT *read_pad_event()
+{
+  PADEVENT *evp = NULL;
+
+  if (!padevent_get(&pevent))
+    return NULL;
+
+  switch (pevent.type)
+  {
+  case PAD_DISCONNECT:
+    watchdog_enable(1, 1);
+    break;
+  case PAD_KEY_PRESS:
+  case PAD_KEY_RELEASE:
+    evp = &pevent;
+    break;
+  default:
+    break;
+  }
+  return evp;
+}
+
+int64_t alarm_callback(alarm_id_t id, void *user_data)
+{
+  post_btreq(BB_CONN);
+  return 0;
+}
+
+uint32_t get_pad_vmask()
+{
+  static uint32_t old_mask;
+  static alarm_id_t aid;
+
+  if (!padevent_get(&pevent))
+  {
+#if PADEVENT_COALESCE
+    static uint32_t last_mask;
+    PADSTATE st;
+    uint32_t mask;
+
+    /* Report a tap between two calls as pressed for one call */
+    read_pad_state(&st);
+    mask = st.in.vbutton | st.pressed;
+    if (mask == last_mask)
+      return old_mask;
+    last_mask = mask;
+    latency_consumed(st.stamp);
+    pevent.type = PAD_KEY_VBMASK;
+    pevent.vmask = mask;
+#else
+    return old_mask;
+#endif
+  }
+
+  if (aid)
+  {
+    cancel_alarm(aid);
+    aid = 0;
+  }
+
+  if (pevent.type == PAD_DISCONNECT)
+  {
+    watchdog_enable(2, 1);
+    return old_mask;
+  }
+  else if (pevent.type == PAD_KEY_VBMASK)
+  {
+    if (pevent.vmask == VBMASK_SHARE || pevent.vmask == VBMASK_OPTION)
+    {
+      aid = add_alarm_in_ms(2000, alarm_callback, NULL, false);
+      return old_mask;
+    }
+  }
+  old_mask = pevent.vmask;
+  return old_mask;
+}
+
+/*
+ * Frame scheduler
+ *
+ * Frames are ticks of fixed 1/60 sec timestep counted from an epoch, so
+ * time spent by the game in a frame does not shift later frames.
+ * frame_wait() sleeps until the deadline of the tick by hardware alarm.
+ * When the game has overrun the deadline it returns at once, and the
+ * following frames catch up. If it is FRAME_CATCHUP_MAX ticks or more
+ * behind, the late ticks are dropped and the epoch restarts from now.
+ */
+#define	FRAME_HZ	60
+#ifndef FRAME_CATCHUP_MAX
+#define	FRAME_CATCHUP_MAX	2
+#endif
+
+static uint64_t frame_epoch;	/* time of tick 0 */
+static uint32_t frame_tick;	/* ticks since epoch */
+static uint64_t frame_start;	/* time when current frame started, 0 before first frame */
+static FRAMESTATS frame_stats;
+
+static uint64_t tick_time(uint32_t tick)
+{
+  return frame_epoch + ((uint64_t)tick * 1000000 + FRAME_HZ / 2) / FRAME_HZ;
+}
+
+static void frame_wait(unsigned short n)
+{
+  uint64_t now, deadline, budget;
+  uint32_t work;
+
+  now = time_us_64();
+  if (frame_start == 0)
+  {
+    frame_epoch = now;
+    frame_tick = 0;
+    frame_start = now;
+  }
+  work = now - frame_start;
+  budget = tick_time(frame_tick + n) - tick_time(frame_tick);
+  frame_tick += n;
+  deadline = tick_time(frame_tick);
+
+  frame_stats.frames++;
+  frame_stats.work_total += work;
+  frame_stats.budget_total += budget;
+  if (work > frame_stats.work_max)
+    frame_stats.work_max = work;
+
+  if (now >= deadline)
+  {
+    if (n > 0)
+      frame_stats.overruns++;
+    if (now - deadline >= tick_time(FRAME_CATCHUP_MAX) - tick_time(0))
+    {
+      frame_stats.dropped += (now - deadline) * FRAME_HZ / 1000000;
+      frame_epoch = now;
+      frame_tick = 0;
+    }
+    frame_start = now;
+    return;
+  }
+  sleep_until(from_us_since_boot(deadline));
+  frame_start = time_us_64();
+  if (frame_start - deadline > frame_stats.late_max)
+    frame_stats.late_max = frame_start - deadline;
+}
+
+/*
+ * Start timing again from the next frame, called when a game starts
+ * so that time spent outside of games is not counted as overrun.
+ */
+void frame_reset()
+{
+  frame_start = 0;
+}
+
+void get_frame_stats(FRAMESTATS *st)
+{
+  *st = frame_stats;
+}
+
+void wait60thsec(unsigned short n){
+	// 60分のn秒ウェイト（前回の期限からnフレーム後まで）
+	flush_graphic(); //フレームバッファの変化を液晶に反映
+	LCD_StatsFrame();
+	latency_frame_done();
+	frame_wait(n);
+}
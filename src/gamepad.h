@@ -111,6 +111,16 @@ struct gamepad_inputs {
   uint8_t battery_level;
 };
 
+/*
+ * Gamepad state returned by read_pad_state()
+ */
+typedef struct {
+  struct gamepad_inputs in;	/* latest state */
+  uint32_t pressed;		/* buttons pressed since previous read */
+  uint32_t released;		/* buttons released since previous read */
+  uint32_t stamp;		/* arrival of report which last changed buttons (LATENCY_STATS) */
+} PADSTATE;
+
 typedef enum {
   PAD_KEY_VBMASK,
   PAD_KEY_PRESS,
@@ -130,6 +140,17 @@ typedef struct {
   void      *ptr;
 } PADEVENT;
 
+/*
+ * Pad event queue counters, updated by the posting side except
+ * coalesced, which is counted by the reading side
+ */
+typedef struct {
+  uint32_t  posted;	/* events and masks posted */
+  uint32_t  dropped;	/* events lost because queue was full */
+  uint32_t  coalesced;	/* masks replaced before game read them */
+  uint32_t  maxlevel;	/* highest number of queued events */
+} PADEVENT_STATS;
+
 typedef struct {
   PADEVENT_TYPE type;
   uint16_t  lvkey;
@@ -174,5 +195,9 @@ extern void post_event(uint16_t type, uint16_t code, void *ptr);
 extern void post_vkeymask(uint32_t mask);
 extern void post_padevent(PADKEY_EVENT *padevent);
 PADEVENT *read_pad_event();
+void get_padevent_stats(PADEVENT_STATS *stats);
+void publish_pad_inputs(const struct gamepad_inputs *in);
+void read_pad_state(PADSTATE *st);
+void pad_state_sync();
 
 #endif
@@ -1,11 +1,305 @@
 //カラーグラフィックライブラリ
 
+#include <string.h>
 #include "picogames.h"
 #include "graphlib.h"
 
+#if defined(SPRITE_CACHE) && defined(USE_FRAMEBUFFER)
+#undef SPRITE_CACHE //フレームバッファ使用時は転送時にパレット変換するため不要
+#endif
+
 unsigned short palette[256];
 static const unsigned char *FontData;
 
+#ifndef USE_FRAMEBUFFER
+static unsigned char composebuf[COMPOSE_SIZE]; //合成用バッファ（カラー番号）
+static unsigned short composeline[2][X_RES]; //DMA転送用ラインバッファ（交互に使用）
+static int compose_x,compose_y,compose_w,compose_h; //合成中の範囲
+static volatile int compose_core=-1; //合成中のコア番号、合成中でない場合-1
+static void compose_exec(const RENDER_CMD *r);
+#define redirected() (render_recording() || compose_core==(int)get_core_num())
+//描画を合成用バッファで行うか記録する場合真
+#else
+#define redirected() render_recording()
+#endif
+
+static void record(unsigned char op,int x,int y,int w,int h,unsigned char a,unsigned char b,unsigned char c,int bc,const void *p)
+// 描画呼び出しをディスプレイリストかレンダーワーカーに追加、後でrender_exec()で実行する
+{
+	RENDER_CMD r;
+	r.op=op;
+	r.x=x;
+	r.y=y;
+	r.w=w;
+	r.h=h;
+	r.a=a;
+	r.b=b;
+	r.c=c;
+	r.bc=bc;
+	r.p=p;
+#ifndef USE_FRAMEBUFFER
+	if(!render_recording()){ //合成中
+		compose_exec(&r);
+		return;
+	}
+#endif
+	render_put(&r);
+}
+
+#ifdef USE_FRAMEBUFFER
+unsigned char framebuffer[Y_RES][X_RES] __attribute__((aligned(4))); //パレット番号によるフレームバッファ（メニュー表示中はLVGLの描画バッファ）
+static short dirtyx1[Y_RES],dirtyx2[Y_RES]; //各ラインの書き換え範囲（x1>x2の場合変化なし）
+static short dirtyy1,dirtyy2; //書き換えのあったラインの範囲
+static unsigned short flushbuf[2][X_RES]; //DMA転送用ラインバッファ（交互に使用）
+
+void set_dirty(int x1,int x2,int y)
+// フレームバッファの(x1,y)-(x2,y)を書き換え済みとして記録
+{
+	if(x1<dirtyx1[y]) dirtyx1[y]=x1;
+	if(x2>dirtyx2[y]) dirtyx2[y]=x2;
+	if(y<dirtyy1) dirtyy1=y;
+	if(y>dirtyy2) dirtyy2=y;
+}
+
+static void clear_dirty(void){
+	int i;
+	for(i=0;i<Y_RES;i++){
+		dirtyx1[i]=X_RES;
+		dirtyx2[i]=-1;
+	}
+	dirtyy1=Y_RES;
+	dirtyy2=-1;
+}
+
+static void flushrect(int x,int y,int w,int h){
+	//フレームバッファの矩形範囲をパレット変換しながら液晶に転送
+	//1ライン変換するごとにDMA転送を開始し、転送中に次のラインを変換する
+	//最後のラインの転送完了とCS解除は次の液晶アクセス時に行われる
+	int i,j,k;
+	const unsigned char *p;
+	unsigned short *q;
+	LCD_setAddrWindow(x,y,w,h);
+	lcd_dc_hi();
+	lcd_cs_lo();
+	k=0;
+	for(i=y;i<y+h;i++){
+		p=&framebuffer[i][x];
+		q=flushbuf[k];
+		for(j=0;j<w;j++) *q++=palette[*p++];
+		lcd_dma_write16(flushbuf[k],w);
+		k^=1;
+	}
+}
+#else
+#define SPAN_GAP 5 //この幅以下の透明部分は背景色で埋めて前後の連続ドットをつなげる
+static unsigned short spanbuf[X_RES]; //連続ドット送信用バッファ
+
+static void putspan(int j1,int j2,int y,const unsigned char *p,int bc)
+// ライン上の(j1,y)-(j2-1,y)にカラー番号の並びpを表示、カラー番号0は透明
+// 不透明ドットの連続ごとにまとめて1回のウィンドウ設定と転送で描画する
+// bc:背景色のカラー番号、0以上の場合は短い透明部分をbcで埋めて1回にまとめる
+{
+	int j,j0,g;
+	unsigned short c,*q;
+	j=j1;
+	while(j<j2){
+		if(p[j-j1]==0){
+			j++;
+			continue;
+		}
+		j0=j;
+		q=spanbuf;
+		while(j<j2){
+			if(p[j-j1]!=0){
+				*q++=palette[p[j-j1]];
+				j++;
+				continue;
+			}
+			if(bc<0) break;
+			for(g=j;g<j2 && p[g-j1]==0;g++) ;
+			if(g>=j2 || g-j>SPAN_GAP) break; //透明部分が長い場合は分割
+			c=palette[bc];
+			for(;j<g;j++) *q++=c;
+		}
+		LCD_WriteRect(j0,y,j-j0,1,spanbuf);
+	}
+}
+
+#ifdef SPRITE_CACHE
+#define CACHE_ENTRIES 192 //キャッシュに登録できるキャラクター数
+#define CACHE_SIZE (16*1024) //展開済みデータ用のドット数
+#define CACHE_HASH 256 //検索用ハッシュテーブルのサイズ
+
+typedef struct {
+	const void *src; //キャラクターのデータ（フォントの場合は文字パターン）
+	unsigned short tag; //フォントの場合は文字色+背景色*256、スプライトの場合0xffff
+	unsigned char valid; //0の場合はパレット変更により再展開が必要
+	short next; //同じハッシュ値の次のエントリー番号+1、0で終わり
+	unsigned short *buf; //展開したRGB565データ
+	unsigned int colors[8]; //使用しているカラー番号のビット
+} CACHEENTRY;
+
+static CACHEENTRY cache[CACHE_ENTRIES];
+static short cache_hash[CACHE_HASH]; //ハッシュ値ごとの最初のエントリー番号+1、0は登録なし
+static int cache_entries; //登録済みのキャラクター数
+static int cache_used; //展開済みデータの使用ドット数
+static unsigned short cache_buf[CACHE_SIZE];
+
+static int cache_hashno(const void *src,unsigned short tag)
+{
+	return (((unsigned int)(uintptr_t)src>>3)^(tag*7))%CACHE_HASH;
+}
+
+static void cache_clear(void)
+// キャッシュを全て破棄
+{
+	LCD_WaitIdle(); //DMA転送中のデータを書き換えないよう終了を待つ
+	memset(cache_hash,0,sizeof(cache_hash));
+	cache_entries=0;
+	cache_used=0;
+}
+
+static CACHEENTRY *cache_find(const void *src,unsigned short tag)
+// キャッシュからキャラクターを検索、見つからない場合NULLを返す
+{
+	int i;
+	for(i=cache_hash[cache_hashno(src,tag)];i>0;i=cache[i-1].next){
+		if(cache[i-1].src==src && cache[i-1].tag==tag) return &cache[i-1];
+	}
+	return NULL;
+}
+
+static CACHEENTRY *cache_add(const void *src,unsigned short tag,int size)
+// キャッシュにsizeドットの領域を確保してキャラクターを登録
+// 満杯の場合は全て破棄してから登録する。データの展開は呼び出し側で行う
+{
+	CACHEENTRY *e;
+	int h;
+	if(size>CACHE_SIZE) return NULL;
+	if(cache_entries>=CACHE_ENTRIES || cache_used+size>CACHE_SIZE) cache_clear();
+	h=cache_hashno(src,tag);
+	e=&cache[cache_entries];
+	e->src=src;
+	e->tag=tag;
+	e->valid=0;
+	e->next=cache_hash[h];
+	e->buf=cache_buf+cache_used;
+	cache_hash[h]=++cache_entries;
+	cache_used+=size;
+	return e;
+}
+
+static void cache_palette_changed(unsigned char n)
+// パレットnを使用しているキャラクターを再展開が必要な状態にする
+{
+	int i;
+	for(i=0;i<cache_entries;i++){
+		if(cache[i].colors[n>>5] & (1u<<(n&31))) cache[i].valid=0;
+	}
+}
+
+static void cache_putpixel(CACHEENTRY *e,unsigned short **q,unsigned char c)
+// パレット番号cのドットをRGB565に展開
+{
+	e->colors[c>>5]|=1u<<(c&31);
+	*(*q)++=palette[c];
+}
+
+static int putsprite_cached(int x,int y,const SPRITE *s,int w,int h)
+// キャッシュに展開済みのデータからスパン形式のキャラクターsを表示
+// 各スパンはキャッシュから直接DMA転送する
+// キャッシュに入らない場合は0を返す
+{
+	CACHEENTRY *e;
+	int k,n,i,j0,j1,j2;
+	const unsigned char *d;
+	unsigned short *q;
+	e=cache_find(s,0xffff);
+	if(e==NULL){
+		d=s->data;
+		n=0;
+		for(k=0;k<s->spans;k++){
+			n+=d[2];
+			d+=3+d[2];
+		}
+		e=cache_add(s,0xffff,n);
+		if(e==NULL) return 0;
+	}
+	d=s->data;
+	if(!e->valid){
+		LCD_WaitIdle(); //DMA転送中のデータを書き換えないよう終了を待つ
+		memset(e->colors,0,sizeof(e->colors));
+		q=e->buf;
+		for(k=0;k<s->spans;k++){
+			for(n=0;n<d[2];n++) cache_putpixel(e,&q,d[3+n]);
+			d+=3+d[2];
+		}
+		e->valid=1;
+		d=s->data;
+	}
+	q=e->buf;
+	for(k=0;k<s->spans;k++){
+		i=y+d[0];
+		j0=x+d[1];
+		n=d[2];
+		d+=3+n;
+		if(i>=0 && i<h){
+			j1=j0<0 ? 0 : j0; //左に切れる場合は残る部分のみ描画
+			j2=j0+n>w ? w : j0+n; //右に切れる場合
+			if(j1<j2) LCD_WriteRectDMA(j1,i,j2-j1,1,q+(j1-j0));
+		}
+		q+=n;
+	}
+	return 1;
+}
+#endif
+#endif
+
+void flush_graphic(void)
+// フレームバッファの書き換えのあった部分を液晶に転送
+// 範囲の重なる連続したラインは1つの矩形にまとめて転送する
+// レンダーワーカー使用時は記録したフレームの描画を開始し、前のフレームの描画終了を待つ
+{
+	render_frame();
+#ifdef USE_FRAMEBUFFER
+	int x1,x2,y,y1;
+	y=dirtyy1;
+	while(y<=dirtyy2){
+		if(dirtyx1[y]>dirtyx2[y]){
+			y++;
+			continue;
+		}
+		y1=y;
+		x1=dirtyx1[y];
+		x2=dirtyx2[y];
+		for(;y<=dirtyy2;y++){
+			if(dirtyx1[y]>x2 || dirtyx2[y]<x1) break; //範囲が重ならない
+			if(dirtyx1[y]<x1) x1=dirtyx1[y];
+			if(dirtyx2[y]>x2) x2=dirtyx2[y];
+			dirtyx1[y]=X_RES;
+			dirtyx2[y]=-1;
+		}
+		flushrect(x1,y1,x2-x1+1,y-y1);
+	}
+	dirtyy1=Y_RES;
+	dirtyy2=-1;
+#endif
+}
+
+void clear_graphic(void)
+// 画面全体をカラー0で消去
+{
+	if(render_recording()){
+		record(RC_CLEAR,0,0,0,0,0,0,0,0,NULL);
+		return;
+	}
+#ifdef USE_FRAMEBUFFER
+	memset(framebuffer,0,sizeof(framebuffer));
+	clear_dirty();
+#endif
+	LCD_Clear(palette[0]);
+}
+
 void set_font_data(const unsigned char *ptr)
 {
   FontData = ptr;
@@ -278,14 +572,33 @@ volatile unsigned short delaytimerflag;
 
 void set_palette(unsigned char n,unsigned char b,unsigned char r,unsigned char g){
 //グラフィック用カラーパレット設定
-	palette[n]=((r>>3)<<11)+((g>>2)<<5)+(b>>3);
+	unsigned short c;
+	if(render_recording()){ //前に記録した描画が古いパレットで行われるよう、パレット変更も記録
+		record(RC_PALETTE,n,0,0,0,b,r,g,0,NULL);
+		return;
+	}
+	c=((r>>3)<<11)+((g>>2)<<5)+(b>>3);
+#ifdef SPRITE_CACHE
+	if(palette[n]!=c) cache_palette_changed(n); //展開済みのキャラクターを無効化
+#endif
+	palette[n]=c;
 }
 
 void pset(int x,int y,unsigned char c)
 // (x,y)の位置にカラーパレット番号cで点を描画
 {
-	if(x>=0 && x<X_RES && y>=0 && y<Y_RES)
+	if(redirected()){
+		record(RC_PSET,x,y,0,0,0,0,c,0,NULL);
+		return;
+	}
+	if(x>=0 && x<X_RES && y>=0 && y<Y_RES){
+#ifdef USE_FRAMEBUFFER
+		framebuffer[y][x]=c;
+		set_dirty(x,x,y);
+#else
 		drawPixel(x,y,palette[c]);
+#endif
+	}
 }
 
 void putbmpmn(int x,int y,unsigned char m,unsigned char n,const unsigned char bmp[])
@@ -293,48 +606,141 @@ void putbmpmn(int x,int y,unsigned char m,unsigned char n,const unsigned char bm
 // unsigned char bmp[m*n]配列に、単純にカラー番号を並べる
 // カラー番号が0の部分は透明色として扱う
 {
-	int i,j;
-	int skip;
-	const unsigned char *p;
+	putbmpmn2(x,y,m,n,bmp,-1);
+}
+
+void putbmpmn2(int x,int y,unsigned char m,unsigned char n,const unsigned char bmp[],int bc)
+// 横m*縦nドットのキャラクターを座標x,yに表示
+// カラー番号が0の部分は透明色として扱う
+// bc:キャラクター下の背景色が分かっている場合そのカラー番号、負数の場合無視
+{
+	int i,i2,j1,j2;
 	if(x<=-m || x>X_RES || y<=-n || y>=Y_RES) return; //画面外
-	if(y<0){ //画面上部に切れる場合
-		i=0;
-		p=bmp-y*m;
+	if(redirected()){ //bmpは描画終了まで書き換えないこと
+		record(RC_BMP,x,y,0,0,m,n,0,bc,bmp);
+		return;
 	}
-	else{
-		i=y;
-		p=bmp;
+	i=y<0 ? 0 : y; //画面上下に切れる場合は残る部分のみ描画
+	i2=y+n>Y_RES ? Y_RES : y+n;
+	j1=x<0 ? 0 : x; //画面左右に切れる場合は残る部分のみ描画
+	j2=x+m>X_RES ? X_RES : x+m;
+	if(j1>=j2) return;
+#ifdef USE_FRAMEBUFFER
+	int j;
+	const unsigned char *p;
+	unsigned char *q;
+	for(;i<i2;i++){
+		p=bmp+(i-y)*m+(j1-x);
+		q=&framebuffer[i][j1];
+		for(j=j1;j<j2;j++){
+			if(*p!=0) *q=*p; //カラー番号が0の場合、透明として処理
+			p++;
+			q++;
+		}
+		set_dirty(j1,j2-1,i);
 	}
-	for(;i<y+n;i++){
-		if(i>=Y_RES) return; //画面下部に切れる場合
-		if(x<0){ //画面左に切れる場合は残る部分のみ描画
-			j=0;
-			p+=-x;
+#else
+	for(;i<i2;i++){
+		putspan(j1,j2,i,bmp+(i-y)*m+(j1-x),bc);
+	}
+#endif
+}
+
+static void putsprite_clip(int x,int y,const SPRITE *s,int bc,int w,int h)
+// スパン形式のキャラクターsを座標x,yに表示、(0,0)-(w-1,h-1)の範囲外は表示しない
+// 透明部分はスパンに含まれないので、ドットごとの透明判定は不要
+// bc:キャラクター下の背景色のカラー番号、負数の場合無視
+{
+	int k,i,j1,j2;
+	const unsigned char *d,*p;
+	if(w>X_RES) w=X_RES;
+	if(h>Y_RES) h=Y_RES;
+	if(x<=-s->m || x>=w || y<=-s->n || y>=h) return; //範囲外
+	if(redirected()){
+		record(RC_SPRITE,x,y,w,h,0,0,0,bc,s);
+		return;
+	}
+#ifdef SPRITE_CACHE
+	if(bc<0 && putsprite_cached(x,y,s,w,h)) return;
+#endif
+	d=s->data;
+#ifdef USE_FRAMEBUFFER
+	for(k=0;k<s->spans;k++){
+		i=y+d[0];
+		j1=x+d[1];
+		j2=j1+d[2];
+		p=d+3;
+		d=p+d[2];
+		if(i<0 || i>=h) continue;
+		if(j1<0){ //左に切れる場合は残る部分のみ描画
+			p-=j1;
+			j1=0;
 		}
-		else{
-			j=x;
+		if(j2>w) j2=w; //右に切れる場合
+		if(j1>=j2) continue;
+		memcpy(&framebuffer[i][j1],p,j2-j1);
+		set_dirty(j1,j2-1,i);
+	}
+#else
+	int sy,sx1,sx2; //送信待ちの連続ドットの行と範囲
+	unsigned short c,*q;
+	sy=sx1=sx2=0;
+	q=spanbuf;
+	for(k=0;k<s->spans;k++){
+		i=y+d[0];
+		j1=x+d[1];
+		j2=j1+d[2];
+		p=d+3;
+		d=p+d[2];
+		if(i<0 || i>=h) continue;
+		if(j1<0){ //左に切れる場合は残る部分のみ描画
+			p-=j1;
+			j1=0;
 		}
-		skip=1;
-		for(;j<x+m;j++){
-			if(j>=X_RES){ //画面右に切れる場合
-				p+=x+m-j;
-				break;
+		if(j2>w) j2=w; //右に切れる場合
+		if(j1>=j2) continue;
+		if(q!=spanbuf){
+			if(i==sy && bc>=0 && j1-sx2<=SPAN_GAP){
+				//間の透明部分を背景色で埋めて前のスパンとつなげる
+				c=palette[bc];
+				for(;sx2<j1;sx2++) *q++=c;
 			}
-			if(*p!=0){ //カラー番号が0の場合、透明として処理
-				if(skip){
-					LCD_SetCursor(j,i);
-					skip=0;
-				}
-				LCD_WriteData2(palette[*p]);
+			else{
+				LCD_WriteRect(sx1,sy,sx2-sx1,1,spanbuf);
+				q=spanbuf;
 			}
-			else skip=1;
-			p++;
 		}
+		if(q==spanbuf){
+			sy=i;
+			sx1=j1;
+		}
+		sx2=j2;
+		for(;j1<j2;j1++) *q++=palette[*p++];
 	}
+	if(q!=spanbuf) LCD_WriteRect(sx1,sy,sx2-sx1,1,spanbuf);
+#endif
+}
+
+void putsprite(int x,int y,const SPRITE *s)
+// スパン形式のキャラクターsを座標x,yに表示
+{
+	putsprite_clip(x,y,s,-1,X_RES,Y_RES);
 }
 
+void putsprite2(int x,int y,const SPRITE *s,int bc)
+// スパン形式のキャラクターsを座標x,yに表示
+// bc:キャラクター下の背景色のカラー番号、負数の場合無視
+{
+	putsprite_clip(x,y,s,bc,X_RES,Y_RES);
+}
+
+void putspriteclip(int x,int y,const SPRITE *s,int w,int h)
+// スパン形式のキャラクターsを座標x,yに表示
+// (0,0)-(w-1,h-1)の範囲外にはみ出した部分は表示しない
+{
+	putsprite_clip(x,y,s,-1,w,h);
+}
 
-void LCD_continuous_output(unsigned short x,unsigned short y,unsigned short color,int n);
 
 // 縦m*横nドットのキャラクター消去
 // カラー0で塗りつぶし
@@ -342,16 +748,26 @@ void clrbmpmn(int x,int y,unsigned char m,unsigned char n)
 {
 	int i,j,k;
 	if(x<=-m || x>X_RES || y<=-n || y>=Y_RES) return; //画面外
+	if(redirected()){
+		record(RC_CLRBMP,x,y,0,0,m,n,0,0,NULL);
+		return;
+	}
 	if(y<0) i=0; //画面上部に切れる場合
 	else i=y;
 	if(x<0) j=0; //画面左に切れる場合は残る部分のみ描画
 	else j=x;
 	if(x+m>=X_RES) k=X_RES-j; //画面右に切れる場合
 	else k=x+m-j;
+#ifdef USE_FRAMEBUFFER
 	for(;i<y+n;i++){
 		if(i>=Y_RES) return; //画面下部に切れる場合
-		LCD_continuous_output(j,i,0,k);
+		memset(&framebuffer[i][j],0,k);
+		set_dirty(j,j+k-1,i);
 	}
+#else
+	if(y+n>Y_RES) n=Y_RES-y; //画面下部に切れる場合
+	LCD_FillRect(j,i,k,y+n-i,0); //DMAで矩形を一括消去
+#endif
 }
 
 void gline(int x1,int y1,int x2,int y2,unsigned char c)
@@ -415,7 +831,16 @@ void hline(int x1,int x2,int y,unsigned char c)
 	if(x2<0 || x1>=X_RES) return;
 	if(x1<0) x1=0;
 	if(x2>=X_RES) x2=X_RES-1;
+	if(redirected()){
+		record(RC_HLINE,x1,y,x2,0,0,0,c,0,NULL);
+		return;
+	}
+#ifdef USE_FRAMEBUFFER
+	memset(&framebuffer[y][x1],c,x2-x1+1);
+	set_dirty(x1,x2,y);
+#else
 	LCD_continuous_output(x1,y,palette[c],x2-x1+1);
+#endif
 }
 
 void circle(int x0,int y0,unsigned int r,unsigned char c)
@@ -460,9 +885,19 @@ void boxfill(int x1,int y1,int x2,int y2,unsigned char c)
 	if(y2<0 || y1>=Y_RES) return;
 	if(y1<0) y1=0;
 	if(y2>=Y_RES) y2=Y_RES-1;
+	if(redirected()){
+		record(RC_BOXFILL,x1,y1,x2,y2,0,0,c,0,NULL);
+		return;
+	}
+#ifdef USE_FRAMEBUFFER
 	while(y1<=y2){
 		hline(x1,x2,y1++,c);
 	}
+#else
+	if(x1<0) x1=0;
+	if(x2>=X_RES) x2=X_RES-1;
+	LCD_FillRect(x1,y1,x2-x1+1,y2-y1+1,palette[c]); //DMAで矩形を一括描画
+#endif
 }
 void circlefill(int x0,int y0,unsigned int r,unsigned char c)
 // (x0,y0)を中心に、半径r、カラーパレット番号cで塗られた円を描画
@@ -493,12 +928,12 @@ void putfont(int x,int y,unsigned char c,int bc,unsigned char n)
 {
 	int i,j;
 	unsigned char d;
-	int skip;
-	unsigned short c1;
 	const unsigned char *p;
-	static unsigned char lcddatabuf[16];
-	unsigned char *lcdbufp;
 	if(x<=-8 || x>=X_RES || y<=-8 || y>=Y_RES) return; //画面外
+	if(redirected()){
+		record(RC_FONT,x,y,0,0,n,0,c,bc,NULL);
+		return;
+	}
 	if(y<0){ //画面上部に切れる場合
 		i=0;
 		p=FontData+n*8-y;
@@ -507,55 +942,90 @@ void putfont(int x,int y,unsigned char c,int bc,unsigned char n)
 		i=y;
 		p=FontData+n*8;
 	}
-	c1=palette[c];
-	if(bc>=0) bc=palette[bc];
+#ifdef USE_FRAMEBUFFER
+	int j1,j2;
+	j1=x<0 ? 0 : x;
+	j2=x+8>X_RES ? X_RES : x+8;
 	for(;i<y+8;i++){
 		if(i>=Y_RES) return; //画面下部に切れる場合
 		d=*p++;
-		if(x<0){ //画面左に切れる場合は残る部分のみ描画
-			j=0;
-			d<<=-x;
-		}
-		else{
-			j=x;
+		d<<=j1-x;
+		for(j=j1;j<j2;j++){
+			if(d&0x80) framebuffer[i][j]=c;
+			else if(bc>=0) framebuffer[i][j]=bc;
+			d<<=1;
 		}
-		if(bc<0){
-			skip=1;
-			for(;j<x+8;j++){
-				if(j>=X_RES){ //画面右に切れる場合
-					break;
+		set_dirty(j1,j2-1,i);
+	}
+#else
+	int i0,j0,j1,j2;
+	unsigned short c1,c2,*q;
+	j1=x<0 ? 0 : x; //画面左右に切れる場合は残る部分のみ描画
+	j2=x+8>X_RES ? X_RES : x+8;
+	c1=palette[c];
+	if(bc<0){
+		//ドットの連続ごとに1回のウィンドウ設定と転送で描画
+		for(;i<y+8;i++){
+			if(i>=Y_RES) return; //画面下部に切れる場合
+			d=*p++;
+			d<<=j1-x;
+			j=j1;
+			while(j<j2){
+				if((d&0x80)==0){
+					j++;
+					d<<=1;
+					continue;
 				}
-				if(d&0x80){
-					if(skip){
-						LCD_SetCursor(j,i);
-						skip=0;
-					}
-					LCD_WriteData2(c1);
+				j0=j;
+				q=spanbuf;
+				while(j<j2 && (d&0x80)){
+					*q++=c1;
+					j++;
+					d<<=1;
 				}
-				else skip=1;
-				d<<=1;
+				LCD_WriteRect(j0,i,j-j0,1,spanbuf);
 			}
 		}
-		else{
-			LCD_SetCursor(j,i);
-			lcdbufp=lcddatabuf;
-			for(;j<x+8;j++){
-				if(j>=X_RES){ //画面右に切れる場合
-					break;
-				}
-				if(d&0x80){
-					*lcdbufp++=c1>>8;
-					*lcdbufp++=(unsigned char)c1;
-				}
-				else{
-					*lcdbufp++=bc>>8;
-					*lcdbufp++=(unsigned char)bc;
+	}
+	else{
+		//背景色ありの場合は文字全体を1回で描画
+#ifdef SPRITE_CACHE
+		if(j2-j1==8 && i==y && y+8<=Y_RES){
+			//画面内に収まる場合は展開済みのデータをキャッシュから直接DMA転送
+			CACHEENTRY *e;
+			e=cache_find(p,c|(bc<<8));
+			if(e==NULL) e=cache_add(p,c|(bc<<8),8*8);
+			if(!e->valid){
+				LCD_WaitIdle(); //DMA転送中のデータを書き換えないよう終了を待つ
+				memset(e->colors,0,sizeof(e->colors));
+				q=e->buf;
+				for(i=0;i<8;i++){
+					d=p[i];
+					for(j=0;j<8;j++){
+						cache_putpixel(e,&q,(d&0x80) ? c : bc);
+						d<<=1;
+					}
 				}
+				e->valid=1;
+			}
+			LCD_WriteRectDMA(x,y,8,8,e->buf);
+			return;
+		}
+#endif
+		c2=palette[bc];
+		i0=i;
+		q=spanbuf;
+		for(;i<y+8 && i<Y_RES;i++){
+			d=*p++;
+			d<<=j1-x;
+			for(j=j1;j<j2;j++){
+				*q++=(d&0x80) ? c1 : c2;
 				d<<=1;
 			}
-			if(lcdbufp!=lcddatabuf) LCD_WriteDataN(lcddatabuf,lcdbufp-lcddatabuf);
 		}
+		LCD_WriteRect(j1,i0,j2-j1,i-i0,spanbuf);
 	}
+#endif
 }
 
 void printstr(int x,int y,unsigned char c,int bc,unsigned char *s){
@@ -600,6 +1070,194 @@ void printnum2(int x,int y,unsigned char c,int bc,unsigned int n,unsigned char e
 	}
 }
 
+#ifndef USE_FRAMEBUFFER
+static void compose_pixel(int x,int y,unsigned char c)
+// 合成用バッファの(x,y)にカラーcの点を描画、範囲外は無視
+{
+	x-=compose_x;
+	y-=compose_y;
+	if(x>=0 && x<compose_w && y>=0 && y<compose_h) composebuf[y*compose_w+x]=c;
+}
+
+static void compose_fill(int x1,int y1,int x2,int y2,unsigned char c)
+// 合成用バッファの(x1,y1)-(x2,y2)をカラーcで塗りつぶし、範囲外は無視
+{
+	x1-=compose_x;
+	x2-=compose_x;
+	y1-=compose_y;
+	y2-=compose_y;
+	if(x1<0) x1=0;
+	if(x2>=compose_w) x2=compose_w-1;
+	if(y1<0) y1=0;
+	if(y2>=compose_h) y2=compose_h-1;
+	if(x1>x2) return;
+	for(;y1<=y2;y1++) memset(&composebuf[y1*compose_w+x1],c,x2-x1+1);
+}
+
+static void compose_exec(const RENDER_CMD *r)
+// 描画を合成用バッファで行う
+{
+	int i,j,k;
+	const unsigned char *d;
+	const SPRITE *s;
+	switch(r->op){
+		case RC_PSET:
+			compose_pixel(r->x,r->y,r->c);
+			break;
+		case RC_BMP:
+			d=r->p;
+			for(i=0;i<r->b;i++){
+				for(j=0;j<r->a;j++){
+					if(*d!=0) compose_pixel(r->x+j,r->y+i,*d); //カラー番号が0の場合、透明として処理
+					d++;
+				}
+			}
+			break;
+		case RC_SPRITE:
+			s=r->p;
+			d=s->data;
+			for(k=0;k<s->spans;k++){
+				i=r->y+d[0];
+				if(i>=0 && i<r->h){ //putsprite_clipの範囲外は表示しない
+					for(j=0;j<d[2];j++){
+						if(r->x+d[1]+j>=0 && r->x+d[1]+j<r->w) compose_pixel(r->x+d[1]+j,i,d[3+j]);
+					}
+				}
+				d+=3+d[2];
+			}
+			break;
+		case RC_CLRBMP:
+			compose_fill(r->x,r->y,r->x+r->a-1,r->y+r->b-1,0);
+			break;
+		case RC_HLINE:
+			compose_fill(r->x,r->y,r->w,r->y,r->c);
+			break;
+		case RC_BOXFILL:
+			compose_fill(r->x,r->y,r->w,r->h,r->c);
+			break;
+		case RC_FONT:
+			d=FontData+r->a*8;
+			for(i=0;i<8;i++){
+				k=*d++;
+				for(j=0;j<8;j++){
+					if(k&0x80) compose_pixel(r->x+j,r->y+i,r->c);
+					else if(r->bc>=0) compose_pixel(r->x+j,r->y+i,r->bc);
+					k<<=1;
+				}
+			}
+			break;
+	}
+}
+#endif
+
+int compose_begin(int x1,int y1,int x2,int y2)
+// (x1,y1)-(x2,y2)の範囲をカラー0で消去し、以後の描画を合成用バッファで行う
+// compose_end()で範囲全体を1回のウィンドウ設定で液晶に転送する
+// 範囲が合成用バッファより大きい場合は何もせず0を返し、描画は通常通り行われる
+// フレームバッファ使用時は範囲を消去するだけで、描画はフレームバッファに直接行う
+{
+	if(x1<0) x1=0;
+	if(x2>=X_RES) x2=X_RES-1;
+	if(y1<0) y1=0;
+	if(y2>=Y_RES) y2=Y_RES-1;
+	if(x1>x2 || y1>y2 || (x2-x1+1)*(y2-y1+1)>COMPOSE_SIZE) return 0;
+	if(render_recording()){
+		record(RC_COMPOSE,x1,y1,x2,y2,0,0,0,0,NULL);
+		return 1;
+	}
+#ifdef USE_FRAMEBUFFER
+	boxfill(x1,y1,x2,y2,0);
+#else
+	compose_x=x1;
+	compose_y=y1;
+	compose_w=x2-x1+1;
+	compose_h=y2-y1+1;
+	memset(composebuf,0,compose_w*compose_h);
+	compose_core=get_core_num();
+#endif
+	return 1;
+}
+
+int compose_move(int x1,int y1,int x2,int y2,unsigned char m,unsigned char n)
+// 横m*縦nドットのキャラクターを(x1,y1)から(x2,y2)に移動する場合に、
+// 移動前と移動後を合わせた矩形でcompose_begin()を行う
+// 移動前の表示の消去と移動後の表示が1回の転送になり、重なる部分を2度送らない
+{
+	return compose_begin(x1<x2 ? x1 : x2,y1<y2 ? y1 : y2,
+		(x1>x2 ? x1 : x2)+m-1,(y1>y2 ? y1 : y2)+n-1);
+}
+
+void compose_end(void)
+// 合成した範囲をパレット変換しながら液晶に転送
+// 1ライン変換するごとにDMA転送を開始し、転送中に次のラインを変換する
+{
+#ifndef USE_FRAMEBUFFER
+	int i,j,k;
+	const unsigned char *p;
+	unsigned short *q;
+#endif
+	if(render_recording()){
+		record(RC_COMPOSE_END,0,0,0,0,0,0,0,0,NULL);
+		return;
+	}
+#ifndef USE_FRAMEBUFFER
+	if(compose_core==(int)get_core_num()){
+		compose_core=-1;
+		LCD_setAddrWindow(compose_x,compose_y,compose_w,compose_h);
+		lcd_dc_hi();
+		lcd_cs_lo();
+		k=0;
+		p=composebuf;
+		for(i=0;i<compose_h;i++){
+			q=composeline[k];
+			for(j=0;j<compose_w;j++) *q++=palette[*p++];
+			lcd_dma_write16(composeline[k],compose_w);
+			k^=1;
+		}
+	}
+#endif
+}
+
+void render_exec(const RENDER_CMD *r)
+// ディスプレイリストの再生やレンダーワーカーから呼ばれ、記録した描画を実行
+{
+	switch(r->op){
+		case RC_PALETTE:
+			set_palette(r->x,r->a,r->b,r->c);
+			break;
+		case RC_CLEAR:
+			clear_graphic();
+			break;
+		case RC_PSET:
+			pset(r->x,r->y,r->c);
+			break;
+		case RC_BMP:
+			putbmpmn2(r->x,r->y,r->a,r->b,r->p,r->bc);
+			break;
+		case RC_SPRITE:
+			putsprite_clip(r->x,r->y,r->p,r->bc,r->w,r->h);
+			break;
+		case RC_CLRBMP:
+			clrbmpmn(r->x,r->y,r->a,r->b);
+			break;
+		case RC_HLINE:
+			hline(r->x,r->w,r->y,r->c);
+			break;
+		case RC_BOXFILL:
+			boxfill(r->x,r->y,r->w,r->h,r->c);
+			break;
+		case RC_FONT:
+			putfont(r->x,r->y,r->c,r->bc,r->a);
+			break;
+		case RC_COMPOSE:
+			compose_begin(r->x,r->y,r->w,r->h);
+			break;
+		case RC_COMPOSE_END:
+			compose_end();
+			break;
+	}
+}
+
 void init_graphic(void){
 	//グラフィックLCD使用開始
 	int i;
@@ -615,5 +1273,5 @@ void init_graphic(void){
 	}
 
 	LCD_Init();
-	LCD_Clear(0);
+	clear_graphic();
 }
@@ -1,3 +1,6 @@
+#ifndef GRAPHLIB_H
+#define GRAPHLIB_H
+
 void set_palette(unsigned char n,unsigned char b,unsigned char r,unsigned char g);
 //グラフィック用カラーパレット設定
 
@@ -9,6 +12,29 @@ void putbmpmn(int x,int y,unsigned char m,unsigned char n,const unsigned char bm
 // unsigned char bmp[m*n]配列に、単純にカラー番号を髞ﾗる
 // カラー番号が0の部分は透明色として扱う
 
+void putbmpmn2(int x,int y,unsigned char m,unsigned char n,const unsigned char bmp[],int bc);
+// 横m*縦nドットのキャラクターを座標x,yに表示、カラー番号が0の部分は透明色
+// bc:キャラクター下の背景色のカラー番号、負数の場合無視
+// 背景色が分かっている場合は短い透明部分を背景色で埋め、転送回数を減らす
+
+typedef struct {
+	unsigned char m,n; //横、縦ドット数
+	unsigned short spans; //不透明部分の連続（スパン）の数
+	const unsigned char *data; //スパンごとに行、開始位置、ドット数、カラー番号の並び
+} SPRITE;
+//ビルド時にtools/spritegen.pyでビットマップから変換したキャラクター
+
+void putsprite(int x,int y,const SPRITE *s);
+// スパン形式のキャラクターsを座標x,yに表示
+
+void putsprite2(int x,int y,const SPRITE *s,int bc);
+// スパン形式のキャラクターsを座標x,yに表示
+// bc:キャラクター下の背景色のカラー番号、負数の場合無視
+
+void putspriteclip(int x,int y,const SPRITE *s,int w,int h);
+// スパン形式のキャラクターsを座標x,yに表示
+// (0,0)-(w-1,h-1)の範囲外にはみ出した部分は表示しない
+
 void clrbmpmn(int x,int y,unsigned char m,unsigned char n);
 // 縦m*横nドットのキャラクター習雕
 // カラー0で塗りつぶし
@@ -48,3 +74,31 @@ void init_graphic(void);
 
 extern unsigned short palette[];
 //パレット用配列
+
+void flush_graphic(void);
+// フレームバッファの書き換えのあった部分を液晶に転送（USE_FRAMEBUFFER指定時のみ）
+
+void clear_graphic(void);
+// 画面全体をカラー0で消去
+
+#define COMPOSE_SIZE (48*48) //合成できる範囲の最大ドット数
+
+int compose_begin(int x1,int y1,int x2,int y2);
+// (x1,y1)-(x2,y2)の範囲をカラー0で消去し、以後の描画を合成用バッファで行う（最大COMPOSE_SIZEドット）
+// 範囲外への描画は無視される。大きすぎる場合は0を返し、描画は通常通り行われる
+
+int compose_move(int x1,int y1,int x2,int y2,unsigned char m,unsigned char n);
+// 横m*縦nドットのキャラクターの(x1,y1)から(x2,y2)への移動前後を合わせた範囲でcompose_begin()を行う
+
+void compose_end(void);
+// 合成した範囲を1回のウィンドウ設定で液晶に転送
+
+#ifdef USE_FRAMEBUFFER
+extern unsigned char framebuffer[Y_RES][X_RES];
+//パレット番号によるフレームバッファ
+
+void set_dirty(int x1,int x2,int y);
+// フレームバッファの(x1,y)-(x2,y)を書き換え済みとして記録
+#endif
+
+#endif
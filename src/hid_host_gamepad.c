@@ -57,6 +57,7 @@
 #include "btstack_config.h"
 #include "gamepad.h"
 #include "btapi.h"
+#include "latency.h"
 
 #define COD_GAMEPAD     0x002508
 #define MAX_ATTRIBUTE_VALUE_SIZE 300
@@ -487,9 +488,11 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
                             // Handle input report.
                             if (padDriver)
                             {
+                                latency_report_received();
                                 hidreport.ptr = (uint8_t *)hid_subevent_report_get_report(packet);
                                 hidreport.len = hid_subevent_report_get_report_len(packet);
                                 (padDriver->DecodeInputReport)(&hidreport);
+                                latency_add(LAT_DECODE, latency_report_stamp());
                             }
                             break;
 
@@ -1,8 +1,90 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
 #include "picogames.h"
 
+#ifdef LCD_STATS
+#define LCD_STATS_PERIOD 60 // 統計を出力するフレーム間隔
+
+LCDSTATS lcd_stats;
+static LCDSTATS stats_last,stats_total,stats_period;
+
+static void stats_add(LCDSTATS *d,const LCDSTATS *s)
+{
+	d->frames+=s->frames;
+	d->commands+=s->commands;
+	d->windows+=s->windows;
+	d->databytes+=s->databytes;
+	d->cstoggles+=s->cstoggles;
+	d->blockedus+=s->blockedus;
+}
+
+void LCD_StatsFrame(void)
+{
+	// Close counters of current frame, called at each frame boundary
+	lcd_stats.frames=1;
+	stats_last=lcd_stats;
+	stats_add(&stats_total,&lcd_stats);
+	stats_add(&stats_period,&lcd_stats);
+	memset(&lcd_stats,0,sizeof(lcd_stats));
+	if(stats_period.frames>=LCD_STATS_PERIOD){
+		printf("lcd: per frame cmd %u win %u data %u cs %u blocked %uus\n",
+			stats_period.commands/stats_period.frames,
+			stats_period.windows/stats_period.frames,
+			stats_period.databytes/stats_period.frames,
+			stats_period.cstoggles/stats_period.frames,
+			stats_period.blockedus/stats_period.frames);
+		memset(&stats_period,0,sizeof(stats_period));
+	}
+}
+
+void LCD_GetStats(LCDSTATS *last,LCDSTATS *total)
+{
+	// Counters of last completed frame and sum of all frames
+	if(last) *last=stats_last;
+	if(total) *total=stats_total;
+}
+
+void LCD_ResetStats(void)
+{
+	memset(&lcd_stats,0,sizeof(lcd_stats));
+	memset(&stats_last,0,sizeof(stats_last));
+	memset(&stats_total,0,sizeof(stats_total));
+	memset(&stats_period,0,sizeof(stats_period));
+}
+
+static void lcd_spi_write(const unsigned char *b,int n)
+{
+	uint32_t t=time_us_32();
+	spi_write_blocking(SPICH,b,n);
+	lcd_stats.blockedus+=time_us_32()-t;
+}
+
+static void lcd_spi_write16(const unsigned short *b,int n)
+{
+	uint32_t t=time_us_32();
+	spi_write16_blocking(SPICH,b,n);
+	lcd_stats.blockedus+=time_us_32()-t;
+}
+#else
+#define lcd_spi_write(b,n) spi_write_blocking(SPICH,b,n)
+#define lcd_spi_write16(b,n) spi_write16_blocking(SPICH,b,n)
+#endif
+
+// Pixel data is sent in 16bit frames, so RGB565 in CPU byte order needs
+// no byte swap. Commands and parameters are sent in 8bit frames.
+// SPI must be idle when the frame size is changed.
+static inline void lcd_spi_frame16(void)
+{
+	spi_set_format(SPICH,16,SPI_CPOL_0,SPI_CPHA_0,SPI_MSB_FIRST);
+}
+
+static inline void lcd_spi_frame8(void)
+{
+	spi_set_format(SPICH,8,SPI_CPOL_0,SPI_CPHA_0,SPI_MSB_FIRST);
+}
+
 static inline void lcd_reset_lo() {
     asm volatile("nop \n nop \n nop");
     gpio_put(LCD_RESET, 0);
@@ -16,21 +98,26 @@ static inline void lcd_reset_hi() {
 
 void LCD_WriteComm(unsigned char comm){
 // Write Command
+	LCD_WaitIdle();
+	LCD_STATS_ADD(commands,1);
 	lcd_dc_lo();
 	lcd_cs_lo();
-	spi_write_blocking(SPICH, &comm , 1);
+	lcd_spi_write(&comm , 1);
 	lcd_cs_hi();
 }
 
 void LCD_WriteComm2(uint8_t *comm, int commlen, uint8_t *param, int paramlen)
 {
+    LCD_WaitIdle();
+    LCD_STATS_ADD(commands, commlen);
     lcd_dc_lo();
     lcd_cs_lo();
-    spi_write_blocking(SPICH, comm , commlen);
+    lcd_spi_write(comm , commlen);
     if (paramlen > 0)
     {
+        LCD_STATS_ADD(databytes, paramlen);
         lcd_dc_hi();
-        spi_write_blocking(SPICH, param , paramlen);
+        lcd_spi_write(param , paramlen);
     }
     lcd_cs_hi();
 }
@@ -38,37 +125,45 @@ void LCD_WriteComm2(uint8_t *comm, int commlen, uint8_t *param, int paramlen)
 void LCD_WriteData(unsigned char data)
 {
 // Write Data
+	LCD_WaitIdle();
+	LCD_STATS_ADD(databytes,1);
 	lcd_dc_hi();
 	lcd_cs_lo();
-	spi_write_blocking(SPICH, &data , 1);
+	lcd_spi_write(&data , 1);
 	lcd_cs_hi();
 }
 
 void LCD_WriteData2(unsigned short data)
 {
 // Write Data 2 bytes
-    unsigned short d;
+	LCD_WaitIdle();
+	LCD_STATS_ADD(databytes,2);
 	lcd_dc_hi();
 	lcd_cs_lo();
-    d=(data>>8) | (data<<8);
-	spi_write_blocking(SPICH, (unsigned char *)&d, 2);
+	lcd_spi_frame16();
+	lcd_spi_write16(&data, 1);
+	lcd_spi_frame8();
 	lcd_cs_hi();
 }
 
 void LCD_WriteDataN(unsigned char *b,int n)
 {
 // Write Data N bytes
+	LCD_WaitIdle();
+	LCD_STATS_ADD(databytes,n);
 	lcd_dc_hi();
 	lcd_cs_lo();
-	spi_write_blocking(SPICH, b,n);
+	lcd_spi_write(b,n);
 	lcd_cs_hi();
 }
 
 void LCD_Read(unsigned char com,unsigned char *b,int n){
+	LCD_WaitIdle();
 	lcd_cs_lo();
 // Write Command
+	LCD_STATS_ADD(commands,1);
 	lcd_dc_lo();
-	spi_write_blocking(SPICH, &com , 1);
+	lcd_spi_write(&com , 1);
 // Read Data
 	lcd_dc_hi();
 	spi_read_blocking(SPICH, 0, b, 1); // dummy read
@@ -183,24 +278,58 @@ void LCD_Init()
 	LCD_WriteComm(0x29);
 }
 
-void LCD_setAddrWindow(unsigned short x,unsigned short y,unsigned short w,unsigned short h)
+static void lcd_window_param(unsigned char comm,unsigned short s,unsigned short e)
+{
+	// Write address command and its start/end parameters, CS must be low
+	unsigned char b[4];
+	b[0]=s>>8;
+	b[1]=(unsigned char)s;
+	b[2]=e>>8;
+	b[3]=(unsigned char)e;
+	lcd_dc_lo();
+	lcd_spi_write(&comm,1);
+	lcd_dc_hi();
+	lcd_spi_write(b,4);
+}
+
+static void lcd_window(unsigned short x,unsigned short y,unsigned short w,unsigned short h)
 {
+	// Set window and start memory write within one CS transaction
+	unsigned char comm=0x2c;
+	LCD_STATS_ADD(windows,1);
+	LCD_STATS_ADD(commands,3);
+	LCD_STATS_ADD(databytes,8);
 #if LCD_ALIGNMENT == VERTICAL
-	LCD_WriteComm(0x2a);
-	LCD_WriteData2(x);
-	LCD_WriteData2(x+w-1);
-	LCD_WriteComm(0x2b);
-	LCD_WriteData2(y);
-	LCD_WriteData2(y+h-1);
+	lcd_window_param(0x2a,x,x+w-1);
+	lcd_window_param(0x2b,y,y+h-1);
 #elif LCD_ALIGNMENT == HORIZONTAL
-	LCD_WriteComm(0x2a);
-	LCD_WriteData2(y);
-	LCD_WriteData2(y+h-1);
-	LCD_WriteComm(0x2b);
-	LCD_WriteData2(x);
-	LCD_WriteData2(x+w-1);
+	lcd_window_param(0x2a,y,y+h-1);
+	lcd_window_param(0x2b,x,x+w-1);
 #endif
-	LCD_WriteComm(0x2c);
+	lcd_dc_lo();
+	lcd_spi_write(&comm,1);
+}
+
+void LCD_setAddrWindow(unsigned short x,unsigned short y,unsigned short w,unsigned short h)
+{
+	LCD_WaitIdle();
+	lcd_cs_lo();
+	lcd_window(x,y,w,h);
+	lcd_cs_hi();
+}
+
+void LCD_WriteRect(unsigned short x,unsigned short y,unsigned short w,unsigned short h,const unsigned short *b)
+{
+	// Set window and write w*h pixels (RGB565) in one CS transaction
+	LCD_WaitIdle();
+	lcd_cs_lo();
+	lcd_window(x,y,w,h);
+	LCD_STATS_ADD(databytes,w*h*2);
+	lcd_dc_hi();
+	lcd_spi_frame16();
+	lcd_spi_write16(b,w*h);
+	lcd_spi_frame8();
+	lcd_cs_hi();
 }
 
 void LCD_SetCursor(unsigned short x, unsigned short y)
@@ -208,32 +337,41 @@ void LCD_SetCursor(unsigned short x, unsigned short y)
 	LCD_setAddrWindow(x,y,X_RES-x,1);
 }
 
-void LCD_continuous_output(unsigned short x,unsigned short y,unsigned short color,int n)
+void LCD_WaitIdle(void)
 {
-	//High speed continuous output
-	int i;
-    unsigned short d;
-	LCD_setAddrWindow(x,y,n,1);
+	// Wait for pending DMA fill and release CS
+	lcd_dma_sync();
+}
+
+void LCD_FillRect(unsigned short x,unsigned short y,unsigned short w,unsigned short h,unsigned short color)
+{
+	// Fill rectangle by DMA, returns without waiting for completion
+	LCD_setAddrWindow(x,y,w,h);
+	LCD_STATS_ADD(databytes,w*h*2);
 	lcd_dc_hi();
 	lcd_cs_lo();
-	d=(color>>8) | (color<<8);
-	for (i=0; i < n ; i++){
-		spi_write_blocking(SPICH, (unsigned char *)&d, 2);
-	}
-	lcd_cs_hi();
+	lcd_dma_fill(color,w*h);
 }
-void LCD_Clear(unsigned short color)
+
+void LCD_WriteRectDMA(unsigned short x,unsigned short y,unsigned short w,unsigned short h,const unsigned short *b)
 {
-	int i;
-    unsigned short d;
-	LCD_setAddrWindow(0,0,X_RES,Y_RES);
-	lcd_dc_hi();
+	// Same as LCD_WriteRect but data is sent by DMA, returns without waiting
+	// The buffer must be kept until the next LCD access
+	LCD_WaitIdle();
 	lcd_cs_lo();
-	d=(color>>8) | (color<<8);
-	for (i=0; i < X_RES*Y_RES ; i++){
-		spi_write_blocking(SPICH, (unsigned char *)&d, 2);
-	}
-	lcd_cs_hi();
+	lcd_window(x,y,w,h);
+	lcd_dc_hi();
+	lcd_dma_write16(b,w*h);
+}
+
+void LCD_continuous_output(unsigned short x,unsigned short y,unsigned short color,int n)
+{
+	//High speed continuous output
+	LCD_FillRect(x,y,n,1,color);
+}
+void LCD_Clear(unsigned short color)
+{
+	LCD_FillRect(0,0,X_RES,Y_RES,color);
 }
 
 void drawPixel(unsigned short x, unsigned short y, unsigned short color)
@@ -244,8 +382,13 @@ void drawPixel(unsigned short x, unsigned short y, unsigned short color)
 
 unsigned short getColor(unsigned short x, unsigned short y)
 {
+#ifdef USE_FRAMEBUFFER
+	// Read back from frame buffer, LCD may not be updated yet
+	return palette[framebuffer[y][x]];
+#else
 	unsigned int d=0;
 	LCD_SetCursor(x,y);
 	LCD_Read(0x2e, (unsigned char *)&d, 3);
 	return ((d&0xf8)<<8)|((d&0xfc00)>>5)|((d&0xf80000)>>19); //RGB565 format
+#endif
 }
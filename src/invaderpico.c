@@ -13,6 +13,7 @@ extern unsigned char bmp_missile1[],bmp_missile2[];
 uint32_t keystatus,keystatus2,oldkey; //最新のボタン状態と前回のボタン状態
 int ufox; //UFO X座標
 int missilex,missiley; //自機ミサイル座標
+static int missiley0; //移動前の自機ミサイルY座標、消去しない場合0
 int al_dir,al_x,al_y,al_conter; //インベーダー移動方向、左上座標、移動速度カウンター
 int zanki; //自機残数
 int explodecounter; //自機爆発中カウンタ
@@ -35,52 +36,9 @@ unsigned int SOUND4[]={0x00040429,0x00020000,3};//UFO SCORE
 unsigned int SOUND5[]={0x00030FFF,0x00010000,30};//CANNON EXPLOSION
 unsigned int * soundarray[]={SOUND1,SOUND2,SOUND3,SOUND4,SOUND5};
 
-//Sound構造体
-struct {
-	unsigned int *p; //曲配列の演奏中の位置
-	unsigned int *start; //曲配列の開始位置
-	unsigned short count; //発音中の音カウンタ
-	unsigned short loop; //曲配列繰り返しカウンタ
-	unsigned char stop; //0:演奏中、1:終了
-} Sound;
-
-void playsound(void){
-//60分の1秒ごとに呼び出し、効果音を変更
-	if(Sound.stop) return; //サウンド停止中
-	Sound.count--;
-	if(Sound.count>0) return;
-	Sound.p++; //次の音へ
-	if(*Sound.p<0x10000){ //上位16ビットが0の場合、繰り返し
-		Sound.loop--;
-		if(Sound.loop==0){
-			sound_off(); //サウンド停止
-			Sound.stop=1;
-			return;
-		}
-		Sound.p=Sound.start; //最初に戻る
-	}
-	Sound.count=*Sound.p>>16;
-	sound_on(*Sound.p&0xffff); //音程設定
-}
 static void sound(int n){
-//効果音開始
-	unsigned int *p;
-	Sound.p=soundarray[n-1];
-	Sound.start=Sound.p;
-	Sound.count=*Sound.p>>16;
-	sound_on(*Sound.p&0xffff); //音程設定
-	Sound.stop=0;
-	p=Sound.p;
-	while(*p>=0x10000) *p++;
-	Sound.loop=*p;
-}
-void wait60thsecwithsound(unsigned short n){
-	// 60分のn秒ウェイト（効果音継続）
-	while(n>0){
-		wait60thsec(1); //60分の1秒ウェイト
-		playsound();
-		n--;
-	}
+//効果音開始、以後はサウンドエンジンがタイマー割り込みで鳴らす
+	sound_tones(SOUND_EFFECT,soundarray[n-1]);
 }
 void keycheck(void){
 //ボタン状態読み取り
@@ -101,7 +59,7 @@ void initgame(void){
 		wait60thsec(1);
 		rand();
 	}
-	Sound.stop=1;
+	sound_stop(SOUND_EFFECT);
 	stage=0;
 	score=0;
 	zanki=3;
@@ -133,10 +91,9 @@ void putzanki(void){
 void clearchar(void){
 // キャラクター表示消去
 	//ミサイル消去
-	if(missiley>0){
-		boxfill(missilex,missiley,missilex+1,missiley+3,0);
-	}
-	else if(missiley==-1){
+	//自機ミサイルは移動後の表示と合わせてputmissile()で消去
+	missiley0=missiley>0 ? missiley : 0;
+	if(missiley==-1){
 		boxfill(missilex-3,0,missilex+4,7,0);
 	}
 	if(al_missiley1>0){
@@ -387,8 +344,19 @@ void checkcollision(void){
 }
 void putmissile(void){
 //ミサイル表示
-	if(missiley>0) putbmpmn(missilex,missiley,1,4,bmp_missile1);
-	else if(missiley<=-2) putfont(missilex-3,0,2,0,0x90); //てっぺんで爆発中
+	if(missiley0>0){
+		if(missiley>0 && compose_move(missilex,missiley0,missilex,missiley,1,4)){
+			//移動前の消去と移動後の表示を1回で転送
+			putbmpmn(missilex,missiley,1,4,bmp_missile1);
+			compose_end();
+		}
+		else{
+			boxfill(missilex,missiley0,missilex+1,missiley0+3,0);
+			if(missiley>0) putbmpmn(missilex,missiley,1,4,bmp_missile1);
+		}
+	}
+	else if(missiley>0) putbmpmn(missilex,missiley,1,4,bmp_missile1);
+	if(missiley<=-2) putfont(missilex-3,0,2,0,0x90); //てっぺんで爆発中
 	if(al_missiley1>0) putbmpmn(al_missilex1,al_missiley1,2,4,bmp_missile2);
 	if(al_missiley2>0) putbmpmn(al_missilex2,al_missiley2,2,4,bmp_missile2);
 	if(al_missiley1<0) putfont(al_missilex1-2,198,2,0,0x91); //地面で爆発中
@@ -482,7 +450,7 @@ static void gameover(void){
 //ゲームオーバー処理
 	putzanki();
 	printstr(74,130,4,0,"GAME OVER");
-	wait60thsecwithsound(240);
+	wait60thsec(240);
 }
 void nextstage(void){
 //次ステージへ進む処理
@@ -490,7 +458,7 @@ void nextstage(void){
 	stage++;
 	if(stage>=2){ //ステージ1の場合は飛ばす
 		printstr(40,60,6,0,"CONGRATULATIONS!");
-		wait60thsecwithsound(60);
+		wait60thsec(60);
 		printstr(60,85,6,0,"NEXT STAGE");
 		wait60thsec(120);
 	}
@@ -559,7 +527,7 @@ void inv_main(void){
 		do{
 			nextstage(); //次ステージへ
 			do{
-				wait60thsecwithsound(1); //60分の1秒ウェイトと効果音更新
+				wait60thsec(1); //60分の1秒ウェイト
 				clearchar(); //キャラクター表示消去
 				keycheck(); //ボタン押下状態読み込み
 				fire(); //ミサイル発射処理
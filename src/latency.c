@@ -0,0 +1,219 @@
+/*
+ * Pico Games
+ *
+ * Input to photon latency measurement.
+ *
+ * Stamps are time_us_32() values, 0 means no stamp. Report arrival and
+ * LAT_DECODE, LAT_ENQUEUE are updated on core0, LAT_CONSUME and
+ * LAT_FLUSH on core1, so each histogram has only one writer.
+ *
+ * With RENDER_WORKER the frame is sent by the worker on core0 after the
+ * game has gone on to the next frame. The stamp is handed to the worker
+ * with the fence of the frame, and the worker adds LAT_FLUSH when it has
+ * run the commands up to the fence. Core1 adds LAT_FLUSH only while no
+ * stamp is handed over, so the histogram still has one writer at a time.
+ * Type 'l' on USB serial to print the histograms, 'r' to clear them.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "picogames.h"
+#include "latency.h"
+
+#ifdef LATENCY_STATS
+
+/*
+ * Histogram buckets are exact below 16us, above that each power of 2
+ * is divided into 8 buckets, so the error is within 12.5%.
+ */
+#define	LAT_SUB_BITS	3
+#define	LAT_LINEAR	16
+#define	LAT_BUCKETS	(LAT_LINEAR + (32 - 4) * (1 << LAT_SUB_BITS))
+
+typedef struct {
+  uint32_t count;
+  uint32_t max;
+  uint32_t bucket[LAT_BUCKETS];
+} LATENCY_HIST;
+
+static LATENCY_HIST lat_hist[LAT_STAGES];
+static volatile uint32_t report_stamp;
+static uint32_t consumed_stamp;
+
+#ifdef RENDER_WORKER
+static uint32_t flush_stamp, flush_fence;	/* written by core1 */
+static volatile uint32_t flush_posted;	/* written by core1 */
+static volatile uint32_t flush_done;	/* written by the worker */
+#endif
+
+static const char *const stage_name[LAT_STAGES] = {
+  "decode", "enqueue", "consume", "flush",
+};
+
+static int lat_bucket(uint32_t us)
+{
+  int e;
+
+  if (us < LAT_LINEAR)
+    return us;
+  e = 31 - __builtin_clz(us);
+  return LAT_LINEAR + ((e - 4) << LAT_SUB_BITS) + ((us >> (e - LAT_SUB_BITS)) & ((1 << LAT_SUB_BITS) - 1));
+}
+
+static uint32_t lat_bucket_top(int b)
+{
+  int e;
+  uint32_t m;
+
+  if (b < LAT_LINEAR)
+    return b;
+  b -= LAT_LINEAR;
+  e = (b >> LAT_SUB_BITS) + 4;
+  m = (1 << LAT_SUB_BITS) + (b & ((1 << LAT_SUB_BITS) - 1));
+  return ((m + 1) << (e - LAT_SUB_BITS)) - 1;
+}
+
+static uint32_t lat_percentile(const LATENCY_HIST *h, int pct)
+{
+  uint32_t n, target;
+  int b;
+
+  target = ((uint64_t)h->count * pct + 99) / 100;
+  n = 0;
+  for (b = 0; b < LAT_BUCKETS; b++)
+  {
+    n += h->bucket[b];
+    if (n >= target)
+      return (lat_bucket_top(b) < h->max) ? lat_bucket_top(b) : h->max;
+  }
+  return h->max;
+}
+
+/*
+ * Called when a HID report has arrived, before it is decoded.
+ */
+void latency_report_received()
+{
+  uint32_t t = time_us_32();
+
+  report_stamp = t ? t : 1;
+}
+
+/*
+ * Arrival time of the report being processed on core0.
+ */
+uint32_t latency_report_stamp()
+{
+  return report_stamp;
+}
+
+void latency_add(LATENCY_STAGE stage, uint32_t stamp)
+{
+  LATENCY_HIST *h = &lat_hist[stage];
+  uint32_t us;
+
+  if (stamp == 0)
+    return;
+  us = time_us_32() - stamp;
+  h->bucket[lat_bucket(us)]++;
+  h->count++;
+  if (us > h->max)
+    h->max = us;
+}
+
+/*
+ * Called by the game side when it has read buttons changed by the
+ * report of the stamp. LAT_FLUSH is taken at the end of this frame.
+ */
+void latency_consumed(uint32_t stamp)
+{
+  if (stamp == 0)
+    return;
+  latency_add(LAT_CONSUME, stamp);
+  if (consumed_stamp == 0)
+    consumed_stamp = stamp;
+}
+
+#ifdef RENDER_WORKER
+/*
+ * Called by render_frame() on core1 before the worker is started on the
+ * frame ending at fence.
+ */
+void latency_frame_fence(uint32_t fence)
+{
+  if (consumed_stamp == 0 || flush_posted != flush_done)
+    return;		/* previous stamp is not taken yet */
+  flush_stamp = consumed_stamp;
+  flush_fence = fence;
+  consumed_stamp = 0;
+  __mem_fence_release();
+  flush_posted++;
+}
+
+/*
+ * Called by the worker on core0 when it has run commands up to tail.
+ */
+void latency_render_done(uint32_t tail)
+{
+  if (flush_posted == flush_done)
+    return;
+  __mem_fence_acquire();
+  if ((int32_t)(tail - flush_fence) < 0)
+    return;
+  latency_add(LAT_FLUSH, flush_stamp);
+  __mem_fence_release();
+  flush_done++;
+}
+#endif
+
+/*
+ * Called at the end of each frame after flush_graphic().
+ */
+void latency_frame_done()
+{
+  int c, direct;
+
+  /*
+   * The render worker owns the SPI while recording, and LAT_FLUSH is
+   * left to it until it has taken the stamp handed over.
+   */
+  direct = !render_recording();
+#ifdef RENDER_WORKER
+  if (flush_posted != flush_done)
+    direct = 0;
+  __mem_fence_acquire();
+#endif
+  if (consumed_stamp && direct)
+  {
+    LCD_WaitIdle();
+    latency_add(LAT_FLUSH, consumed_stamp);
+    consumed_stamp = 0;
+  }
+  c = getchar_timeout_us(0);
+  if (c == 'l')
+    latency_print();
+  else if (c == 'r')
+    latency_reset();
+}
+
+void latency_print()
+{
+  int i;
+
+  for (i = 0; i < LAT_STAGES; i++)
+  {
+    const LATENCY_HIST *h = &lat_hist[i];
+
+    printf("latency %-7s n %u p50 %uus p99 %uus max %uus\n", stage_name[i],
+           h->count, lat_percentile(h, 50), lat_percentile(h, 99), h->max);
+  }
+}
+
+void latency_reset()
+{
+  memset(lat_hist, 0, sizeof(lat_hist));
+  consumed_stamp = 0;
+}
+
+#endif
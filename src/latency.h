@@ -0,0 +1,48 @@
+/*
+ * Pico Games
+ *
+ * Input to photon latency measurement, enabled by LATENCY_STATS.
+ */
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/*
+ * Each HID report is stamped when it arrives. The stamp follows the
+ * buttons changed by the report through the pad snapshot to the game,
+ * and time from arrival to each stage is added to its histogram.
+ */
+typedef enum {
+  LAT_DECODE,		/* report decoded by gamepad driver */
+  LAT_ENQUEUE,		/* changed buttons posted for the game */
+  LAT_CONSUME,		/* game read the changed buttons */
+  LAT_FLUSH,		/* frame drawn after the read was sent to LCD */
+  LAT_STAGES,
+} LATENCY_STAGE;
+
+#ifdef LATENCY_STATS
+void latency_report_received(void);
+uint32_t latency_report_stamp(void);
+void latency_add(LATENCY_STAGE stage, uint32_t stamp);
+void latency_consumed(uint32_t stamp);
+void latency_frame_done(void);
+void latency_print(void);
+void latency_reset(void);
+#ifdef RENDER_WORKER
+void latency_frame_fence(uint32_t fence);
+void latency_render_done(uint32_t tail);
+#endif
+#else
+#define latency_report_received() ((void)0)
+#define latency_report_stamp() 0
+#define latency_add(stage, stamp) ((void)0)
+#define latency_consumed(stamp) ((void)0)
+#define latency_frame_done() ((void)0)
+#define latency_print() ((void)0)
+#define latency_reset() ((void)0)
+#define latency_frame_fence(fence) ((void)0)
+#define latency_render_done(tail) ((void)0)
+#endif
+
+#endif
@@ -18,19 +18,27 @@
 
 extern int btstack_main(int argc, const char *argv[]);
 
-mutex_t padevent_mutex;
-queue_t padevent_queue;
-
 btstack_packet_callback_registration_t hci_event_callback_registration;
 
 void game_main(void);
 static int wsmode;
 
+#ifdef RENDER_WORKER
+static btstack_data_source_t render_source;
+
+/*
+ * Draw commands recorded by the game on core1, polled when it kicks.
+ */
+static void render_process(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+  render_worker();
+}
+#endif
+
 int game_core_init()
 {
 
-  mutex_init(&padevent_mutex);
-  queue_init(&padevent_queue, sizeof(PADEVENT), 4);
+  padevent_init();
   multicore_reset_core1();
 
   wsmode = apds_init();
@@ -101,153 +109,16 @@ int main(int argc, const char **argv)
     hci_add_event_handler(&hci_event_callback_registration);
 
     btstack_main(argc, argv);
+#ifdef RENDER_WORKER
+    btstack_run_loop_enable_data_source_callbacks(&render_source, DATA_SOURCE_CALLBACK_POLL);
+    btstack_run_loop_set_data_source_handler(&render_source, &render_process);
+    btstack_run_loop_add_data_source(&render_source);
+    render_set_kick(btstack_run_loop_poll_data_sources_from_irq);
+#endif
     btstack_run_loop_execute();
   }
 }
 
-void post_event(uint16_t type, uint16_t code, void *ptr)
-{
-  PADEVENT event;
-
-  mutex_enter_blocking(&padevent_mutex);
-  if (!queue_is_full(&padevent_queue))
-  {
-    event.type = type;
-    event.key_code = code;
-    event.ptr = ptr;
-
-    queue_try_add(&padevent_queue, &event);
-  }
-  mutex_exit(&padevent_mutex);
-}
-
-void post_padevent(PADKEY_EVENT *padevent)
-{
-  PADEVENT event;
-
-  mutex_enter_blocking(&padevent_mutex);
-  if (!queue_is_full(&padevent_queue))
-  {
-    event.type = padevent->type;
-    if (padevent->type == PAD_KEY_VBMASK)
-    {
-      event.key_code = 0;
-      event.vmask = padevent->vmask;
-      event.ptr = NULL;
-    }
-    else
-    {
-      event.key_code = padevent->lvkey;
-      event.vmask = 0;
-      event.ptr = NULL;
-    }
-    queue_try_add(&padevent_queue, &event);
-  }
-  mutex_exit(&padevent_mutex);
-}
-
-void post_vkeymask(uint32_t mask)
-{
-  PADEVENT event;
-
-  mutex_enter_blocking(&padevent_mutex);
-  if (!queue_is_full(&padevent_queue))
-  {
-    event.type = PAD_KEY_VBMASK;
-    event.key_code = 0;
-    event.vmask = mask;
-    event.ptr = NULL;
-
-    queue_try_add(&padevent_queue, &event);
-  }
-  mutex_exit(&padevent_mutex);
-}
-
-static PADEVENT pevent;
-
-int check_pad_connect()
-{
-  if (queue_is_empty(&padevent_queue))
-    return 0;
-  mutex_enter_blocking(&padevent_mutex);
-  queue_remove_blocking(&padevent_queue, &pevent);
-  mutex_exit(&padevent_mutex);
-  if (pevent.type == PAD_CONNECT)
-    return 1;
-  return 0;
-}
-
-PADEVENT *read_pad_event()
-{
-  PADEVENT *evp = NULL;
-
-  if (queue_is_empty(&padevent_queue))
-    return NULL;
-  mutex_enter_blocking(&padevent_mutex);
-  queue_remove_blocking(&padevent_queue, &pevent);
-  mutex_exit(&padevent_mutex);
-
-  switch (pevent.type)
-  {
-  case PAD_DISCONNECT:
-    watchdog_enable(1, 1);
-    break;
-  case PAD_KEY_PRESS:
-  case PAD_KEY_RELEASE:
-    evp = &pevent;
-    break;
-  default:
-    break;
-  }
-  return evp;
-}
-
-int64_t alarm_callback(alarm_id_t id, void *user_data)
-{
-  post_btreq(BB_CONN);
-  return 0;
-}
-
-uint32_t get_pad_vmask()
-{
-  static uint32_t old_mask;
-  static alarm_id_t aid;
-
-  if (queue_is_empty(&padevent_queue))
-    return old_mask;
-  mutex_enter_blocking(&padevent_mutex);
-  queue_remove_blocking(&padevent_queue, &pevent);
-  mutex_exit(&padevent_mutex);
-
-  if (aid)
-  {
-    cancel_alarm(aid);
-    aid = 0;
-  }
-
-  if (pevent.type == PAD_DISCONNECT)
-  {
-    watchdog_enable(2, 1);
-    return old_mask;
-  }
-  else if (pevent.type == PAD_KEY_VBMASK)
-  {
-    if (pevent.vmask == VBMASK_SHARE || pevent.vmask == VBMASK_OPTION)
-    {
-      aid = add_alarm_in_ms(2000, alarm_callback, NULL, false);
-      return old_mask;
-    }
-  }
-  old_mask = pevent.vmask;
-  return old_mask;
-}
-
-void wait60thsec(unsigned short n){
-	// 60分のn秒ウェイト
-	uint64_t t=to_us_since_boot(get_absolute_time())%16667;
-	sleep_us(16667*n-t);
-}
-
 void game_main()
 {
   extern int run_menu(int mode);
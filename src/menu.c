@@ -9,13 +9,24 @@
 #include <stdio.h>
 #endif
 
-#define	DBUF_LINES	60
-#define	DBUF_SIZE	(240*2*DBUF_LINES)
-
 #define	BLINK_PERIOD	250
 
-static uint8_t disp_buffer1[DBUF_SIZE];
-static uint8_t swap_buffer[DBUF_SIZE];
+/* LVGL renders into one buffer while the other is sent by DMA */
+#ifdef USE_FRAMEBUFFER
+/*
+ * Menu is finished before a game starts, so the two halves of the game
+ * frame buffer are used instead of buffers of its own.
+ */
+#define	DBUF_SIZE	(sizeof(framebuffer)/2)
+static uint8_t *const disp_buffer1 = &framebuffer[0][0];
+static uint8_t *const disp_buffer2 = &framebuffer[Y_RES/2][0];
+#else
+#define	DBUF_LINES	60
+#define	DBUF_SIZE	(240*2*DBUF_LINES)
+static uint8_t disp_buffer1[DBUF_SIZE] __attribute__((aligned(4)));
+static uint8_t disp_buffer2[DBUF_SIZE] __attribute__((aligned(4)));
+#endif
+static lv_display_t *flush_disp;
 
 static struct repeating_timer blink_timer;
 static lv_obj_t *button;
@@ -36,21 +47,22 @@ static void send_cmd_cb(lv_display_t *disp, const uint8_t *cmd, size_t cmd_size,
   LCD_WriteComm2((uint8_t *)cmd, cmd_size, (uint8_t *)param, param_size);
 }
 
-static void send_color_cb(lv_display_t *disp, const uint8_t *cmd, size_t cmd_size, uint8_t *param, size_t param_size)
+/*
+ * Called from DMA interrupt when the buffer has been read out
+ */
+static void flush_done(void)
 {
-  LV_UNUSED(disp);
-  uint8_t *dst = swap_buffer;
-
-  for (int i = 0; i < param_size; i+= 2)
-  {
-    *dst++ = param[1];
-    *dst++ = param[0];
-    param += 2;
-  }
-
-  lcd_send_data(cmd, cmd_size, swap_buffer, param_size);
+  lv_display_flush_ready(flush_disp);
+}
 
-  lv_display_flush_ready(disp);
+/*
+ * Pixels are sent as 16bit SPI frames, so LVGL's RGB565 needs no byte swap.
+ * Returns while DMA is running, LVGL renders next area into the other buffer.
+ */
+static void send_color_cb(lv_display_t *disp, const uint8_t *cmd, size_t cmd_size, uint8_t *param, size_t param_size)
+{
+  flush_disp = disp;
+  lcd_send_data16(cmd, cmd_size, (const uint16_t *)param, param_size / 2, flush_done);
 }
 
 /*
@@ -183,7 +195,7 @@ int run_menu(int wsmode)
   setup_lvgl_tick();
 
   disp = lv_ili9341_create(240, 320, 0, send_cmd_cb, send_color_cb);
-  lv_display_set_buffers(disp, disp_buffer1, NULL, DBUF_SIZE, LV_DISPLAY_RENDER_MODE_PARTIAL);
+  lv_display_set_buffers(disp, disp_buffer1, disp_buffer2, DBUF_SIZE, LV_DISPLAY_RENDER_MODE_PARTIAL);
 
   indev = lv_indev_create();
   lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
@@ -280,6 +292,14 @@ int run_menu(int wsmode)
 
   set_hid_mode(HID_MODE_GAME);
 
+#ifdef USE_FRAMEBUFFER
+  /* Give the frame buffer back to the game after the last flush */
+  lcd_dma_sync();
+  clear_graphic();
+#endif
+
+  frame_reset();
+  pad_state_sync();
   (*sel_game)();
 
   return 0;
@@ -103,11 +103,11 @@
 //_Character構造体定義
 //パックマン、モンスター4匹のオブジェクト
 typedef struct {
-	unsigned short x; // x座標（下位8ビットは小数点以下）
-	unsigned short y; // y座標（下位8ビットは小数点以下）
-	unsigned short oldx; // 前回x座標（下位8ビットは小数点以下）
-	unsigned short oldy; // 前回y座標（下位8ビットは小数点以下）
-	unsigned short speed; // 移動速度
+	UFIX8 x; // x座標（下位8ビットは小数点以下）
+	UFIX8 y; // y座標（下位8ビットは小数点以下）
+	UFIX8 oldx; // 前回x座標（下位8ビットは小数点以下）
+	UFIX8 oldy; // 前回y座標（下位8ビットは小数点以下）
+	UFIX8 speed; // 移動速度（1フレームの移動ドット数）
 	unsigned char no; // モンスターの番号
 	unsigned char status; // 現在のモード
 	unsigned char dir; // 移動方向 0:上、1:右、2:下、3:左
@@ -118,27 +118,45 @@ typedef struct {
 	unsigned short modecount; // 現在のモードのカウンター
 } _Character;
 
-//_Music構造体定義
+//_Area構造体定義
+//キャラクター表示範囲の書き直しに使うマップ上の矩形
 typedef struct {
-	unsigned char *p; //曲配列の演奏中の位置
-	unsigned char count; //発音中の音カウンタ
-	unsigned char stop; //0:演奏中、1:終了
-} _Music;
+	unsigned char x1,y1; // 左上のマップ座標
+	unsigned char x2,y2; // 右下のマップ座標
+} _Area;
+
+//_GameState構造体定義
+//pacman_step()で1フレーム進めた後のゲームの状態
+typedef struct {
+	unsigned int score; // 得点
+	unsigned char stage; // 現在のステージ数
+	unsigned char player; // パックマン残数
+	unsigned char cookie; // えさ残数
+	unsigned char gamestatus; // 1:ゲーム中、4:ゲームオーバー
+	unsigned char gamecount; // 全体カウンター
+	_Character chars[5]; // パックマン、アカベイ、ピンキー、アオスケ、グズタ
+	// マップのビットボード（MAPYSIZE行、ビットxがマスx）
+	const uint32_t *wallbits,*cookiebits,*powerbits,*doorbits;
+} _GameState;
+
+// 表示とウェイトなしでゲームを進める（ホストでの回帰テスト、思考ルーチンの実験、プロファイル用）
+void pacman_reset(unsigned char h); // h=1で表示なし。ゲームを開始し1面のゲーム中にする
+unsigned char pacman_step(uint32_t keys,_GameState *st); // キー入力keysで1フレーム進める。stは不要ならNULL
 
 extern const unsigned char FontData[]; //フォントパターン定義
-extern const unsigned char Pacmanbmp[][14*14]; //パックマンビットマップ
-extern const unsigned char Pacmandeadbmp[][14*14]; //パックマンビットマップ
-extern const unsigned char Monsterbmp[][14*13]; //モンスタービットマップ
-extern const unsigned char Ijikebmp[][14*13]; //イジケビットマップ
-extern const unsigned char Medamabmp[][14*13]; //目玉ビットマップ
-extern const unsigned char Fruitbmp[][12*14]; //フルーツビットマップ
-extern const unsigned char Scorebmp[][16*7]; //スコアビットマップ
-extern const unsigned char Bigpacbmp[][31*31]; //巨大パックマンビットマップ
-extern const unsigned char Pinbmp[]; //白いピンビットマップ
-extern const unsigned char Yabukebmp[][22*13]; //破けモンスタービットマップ
-extern const unsigned char Yabuke2bmp[][14*13]; //破けモンスター2ビットマップ
-extern const unsigned char Hadakabmp[][22*13]; //裸モンスタービットマップ
-extern const unsigned char Titlelogobmp[][114]; //タイトルロゴビットマップ
+extern const SPRITE Pacmanspr[]; //パックマンビットマップ
+extern const SPRITE Pacmandeadspr[]; //パックマンビットマップ
+extern const SPRITE Monsterspr[]; //モンスタービットマップ
+extern const SPRITE Ijikespr[]; //イジケビットマップ
+extern const SPRITE Medamaspr[]; //目玉ビットマップ
+extern const SPRITE Fruitspr[]; //フルーツビットマップ
+extern const SPRITE Scorespr[]; //スコアビットマップ
+extern const SPRITE Bigpacspr[]; //巨大パックマンビットマップ
+extern const SPRITE Pinspr[]; //白いピンビットマップ
+extern const SPRITE Yabukespr[]; //破けモンスタービットマップ
+extern const SPRITE Yabuke2spr[]; //破けモンスター2ビットマップ
+extern const SPRITE Hadakaspr[]; //裸モンスタービットマップ
+extern const SPRITE Titlelogospr[]; //タイトルロゴビットマップ
 
 
 
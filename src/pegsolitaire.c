@@ -13,6 +13,8 @@
 // グローバル変数定義
 static uint32_t keystatus,keystatus2,oldkey; //最新のボタン状態と前回のボタン状態
 static unsigned char board[BOARDYSIZE][BOARDXSIZE]; //盤の状態
+static void drawball(int x,int y,unsigned char tile,unsigned char color);
+static TILEMAP boardmap={0,0,BOARDXSIZE,BOARDYSIZE,BOARDXSIZE,BALLXSIZE,BALLYSIZE,&board[0][0],NULL,drawball}; //board配列を表示するタイルマップ
 unsigned char undob[BOARDXSIZE*BOARDYSIZE][BOARDYSIZE][BOARDXSIZE]; //盤の状態
 int balls; //ボール残数
 int step; //現在の手数
@@ -230,21 +232,22 @@ static void gameinit(void){
 	//ボタン連続押し防止の初期設定
 	keystatus=KEYUP | KEYDOWN | KEYLEFT | KEYRIGHT | KEYSTART | KEYFIRE;
 }
+static void drawball(int x,int y,unsigned char tile,unsigned char color){
+//タイルマップから呼ばれ、board配列の値tileのマスを表示（盤の外の0は描画しない）
+	if(tile==1) putbmpmn(x,y,BALLXSIZE,BALLYSIZE,BMP1);
+	else putbmpmn(x,y,BALLXSIZE,BALLYSIZE,BMP2);
+}
 void putboard(void){
 //盤全体を再描画
 	int i,j;
 	balls=0;
 	for(i=0;i<BOARDYSIZE;i++){
 		for(j=0;j<BOARDXSIZE;j++){
-			if(board[i][j]==1){
-				putbmpmn(j*BALLXSIZE,i*BALLYSIZE,BALLXSIZE,BALLYSIZE,BMP1);
-				balls++;
-			}
-			else if(board[i][j]==2){
-				putbmpmn(j*BALLXSIZE,i*BALLYSIZE,BALLXSIZE,BALLYSIZE,BMP2);
-			}
+			if(board[i][j]) tilemap_dirty(&boardmap,j,i);
+			if(board[i][j]==1) balls++;
 		}
 	}
+	tilemap_flush(&boardmap); //横に並んだマスはまとめて転送
 	score();
 }
 void putcursor(int x,int y,unsigned char c){
@@ -355,12 +358,10 @@ int movecheck(void){
 }
 void move3(void){
 // ボールを移動させ、飛び越えたボールを取り除く
-	putbmpmn(cursorx2*BALLXSIZE,cursory2*BALLYSIZE,BALLXSIZE,BALLYSIZE,BMP1);
-	putbmpmn(cursorx1*BALLXSIZE,cursory1*BALLYSIZE,BALLXSIZE,BALLYSIZE,BMP2);
-	putbmpmn((cursorx1+cursorx2)/2*BALLXSIZE,(cursory1+cursory2)/2*BALLYSIZE,BALLXSIZE,BALLYSIZE,BMP2);
-	board[cursory2][cursorx2]=1;
-	board[cursory1][cursorx1]=2;
-	board[(cursory1+cursory2)/2][(cursorx1+cursorx2)/2]=2;
+	tilemap_put(&boardmap,cursorx2,cursory2,1,0);
+	tilemap_put(&boardmap,cursorx1,cursory1,2,0);
+	tilemap_put(&boardmap,(cursorx1+cursorx2)/2,(cursory1+cursory2)/2,2,0);
+	tilemap_flush(&boardmap);
 	balls--;
 	cursorx1=cursorx2;
 	cursory1=cursory2;
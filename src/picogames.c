@@ -5,6 +5,7 @@
  *
  */
 #include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "hardware/pwm.h"
 #include "hardware/spi.h"
 #include "pico/stdlib.h"
@@ -24,6 +25,11 @@ int32_t msraw;
 
 static uint spi_dma;
 static dma_channel_config  dma_config;
+static dma_channel_config  fill_config;
+static volatile uint16_t fill_color;
+static dma_channel_config  send16_config;
+static bool spi16_pending;	/* SPI is in 16bit frames until lcd_dma_sync() */
+static void (*dma_done)(void);
 
 void sound_init()
 {
@@ -33,8 +39,19 @@ void sound_init()
     pwm_set_wrap(pwm_slice_num, PWM_WRAP-1);
     // duty 50%
     pwm_set_chan_level(pwm_slice_num, SOUND_CHAN, PWM_WRAP/2);
+    sound_engine_init(pwm_slice_num);
 }
 
+#ifdef SOUND_MIXER
+// ミキサー使用時は最後のボイスで鳴らす
+void sound_on(uint16_t f){
+    mixer_period(MIXER_VOICES-1, f);
+}
+
+void sound_off(void){
+    mixer_period(MIXER_VOICES-1, SOUND_END);
+}
+#else
 void sound_on(uint16_t f){
     pwm_set_clkdiv_int_frac(pwm_slice_num, f>>4, f&15);
     pwm_set_enabled(pwm_slice_num, true);
@@ -43,6 +60,7 @@ void sound_on(uint16_t f){
 void sound_off(void){
     pwm_set_enabled(pwm_slice_num, false);
 }
+#endif
 
 static volatile int isr_flag;
 
@@ -52,6 +70,24 @@ void touch_irq_callback(uint gpio, uint32_t events)
   isr_flag = 1;
 }
 
+/*
+ * DMA completion interrupt, enabled only while a transfer started by
+ * lcd_send_data16() is running.
+ */
+static void lcd_dma_irq_handler(void)
+{
+    void (*done)(void);
+
+    if (!dma_channel_get_irq0_status(spi_dma))
+      return;
+    dma_channel_acknowledge_irq0(spi_dma);
+    dma_channel_set_irq0_enabled(spi_dma, false);
+    done = dma_done;
+    dma_done = NULL;
+    if (done)
+      done();
+}
+
 void lcd_port_init()
 {
 	// 液晶用ポート設定
@@ -76,6 +112,20 @@ void lcd_port_init()
     dma_config = dma_channel_get_default_config(spi_dma);
     channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_8);
     channel_config_set_dreq(&dma_config, spi_get_dreq(SPICH, true));
+
+    /* Solid fill sends the same 16bit word again and again */
+    fill_config = dma_channel_get_default_config(spi_dma);
+    channel_config_set_transfer_data_size(&fill_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&fill_config, false);
+    channel_config_set_dreq(&fill_config, spi_get_dreq(SPICH, true));
+
+    /* RGB565 pixels in CPU byte order sent as 16bit frames */
+    send16_config = dma_channel_get_default_config(spi_dma);
+    channel_config_set_transfer_data_size(&send16_config, DMA_SIZE_16);
+    channel_config_set_dreq(&send16_config, spi_get_dreq(SPICH, true));
+
+    irq_add_shared_handler(DMA_IRQ_0, lcd_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
 #endif
 
     /* Setup touch port */
@@ -93,8 +143,117 @@ void lcd_port_init()
   
 }
 
+/*
+ * Start DMA transfer of pixel data to LCD. Caller must assert CS and DC.
+ * Previous transfer is waited for, so the caller may fill another buffer
+ * while this one is being sent.
+ */
+void lcd_dma_write(const uint8_t *bp, int dlen)
+{
+#ifdef LCD_STATS
+    uint32_t t = time_us_32();
+    dma_channel_wait_for_finish_blocking(spi_dma);
+    lcd_stats.blockedus += time_us_32() - t;
+    lcd_stats.databytes += dlen;
+#else
+    dma_channel_wait_for_finish_blocking(spi_dma);
+#endif
+    dma_channel_configure(spi_dma, &dma_config,
+           &spi_get_hw(SPICH)->dr,
+           bp,
+           dlen,
+           true);
+}
+
+/*
+ * Wait until all DMA data has been shifted out of SPI.
+ * DMA completion only means the data is in TX FIFO, so also wait for
+ * BSY and discard received bytes as spi_write_blocking() does.
+ */
+void lcd_dma_wait()
+{
+#ifdef LCD_STATS
+    uint32_t t = time_us_32();
+#endif
+    dma_channel_wait_for_finish_blocking(spi_dma);
+    while (spi_is_busy(SPICH))
+      tight_loop_contents();
+    while (spi_is_readable(SPICH))
+      (void)spi_get_hw(SPICH)->dr;
+    spi_get_hw(SPICH)->icr = SPI_SSPICR_RORIC_BITS;
+#ifdef LCD_STATS
+    lcd_stats.blockedus += time_us_32() - t;
+#endif
+}
+
+/*
+ * Start filling n pixels with color. Caller must assert CS and DC and
+ * set address window. SPI is switched to 16bit frames during the fill,
+ * so the color needs no byte swap. Returns without waiting, the fill
+ * is completed and CS released by lcd_dma_sync().
+ */
+void lcd_dma_fill(uint16_t color, int n)
+{
+    lcd_dma_sync();
+    fill_color = color;
+    spi_set_format(SPICH, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    dma_channel_configure(spi_dma, &fill_config,
+           &spi_get_hw(SPICH)->dr,
+           &fill_color,
+           n,
+           true);
+    spi16_pending = true;
+}
+
+/*
+ * Start sending n pixels of RGB565 in CPU byte order. Caller must assert
+ * CS and DC and set address window. SPI is switched to 16bit frames, so
+ * the pixels need no byte swap. If the previous lcd_dma_write16() is
+ * still running, it is waited for and this one continues in the same
+ * CS transaction, so the caller may fill another buffer meanwhile.
+ * Returns without waiting, the buffer must be kept unchanged until
+ * lcd_dma_sync() completes the transfer.
+ */
+void lcd_dma_write16(const uint16_t *px, int n)
+{
+#ifdef LCD_STATS
+    uint32_t t = time_us_32();
+    dma_channel_wait_for_finish_blocking(spi_dma);
+    lcd_stats.blockedus += time_us_32() - t;
+    lcd_stats.databytes += n * 2;
+#else
+    dma_channel_wait_for_finish_blocking(spi_dma);
+#endif
+    if (!spi16_pending)
+    {
+      spi_set_format(SPICH, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+      spi16_pending = true;
+    }
+    dma_channel_configure(spi_dma, &send16_config,
+           &spi_get_hw(SPICH)->dr,
+           px,
+           n,
+           true);
+}
+
+/*
+ * Fence for lcd_dma_fill() and lcd_dma_write16(). Every LCD access calls
+ * this first.
+ */
+void lcd_dma_sync()
+{
+    if (!spi16_pending)
+      return;
+    lcd_dma_wait();
+    spi_set_format(SPICH, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    lcd_cs_hi();
+    spi16_pending = false;
+}
+
 void lcd_send_data(const uint8_t *cmd, int cmd_size, uint8_t *bp, int dlen)
 {
+    lcd_dma_sync();
+    LCD_STATS_ADD(commands, cmd_size);
     lcd_dc_lo();
     lcd_cs_lo();
     if (cmd_size > 0)
@@ -102,16 +261,45 @@ void lcd_send_data(const uint8_t *cmd, int cmd_size, uint8_t *bp, int dlen)
     lcd_dc_hi();
     if (dlen > 0)
     {
-      dma_channel_configure(spi_dma, &dma_config,
-           &spi_get_hw(SPICH)->dr,
-           bp,
-           dlen,
-           true);
-      dma_channel_wait_for_finish_blocking(spi_dma);
+      lcd_dma_write(bp, dlen);
+      lcd_dma_wait();
     }
     lcd_cs_hi();
 }
 
+/*
+ * Send command and n pixels of RGB565 in CPU byte order. SPI is switched
+ * to 16bit frames, so the pixels need no byte swap. Returns without
+ * waiting. done() is called from DMA interrupt as soon as DMA has read
+ * the whole buffer, the rest of the transfer is completed by lcd_dma_sync().
+ */
+void lcd_send_data16(const uint8_t *cmd, int cmd_size, const uint16_t *px, int n, void (*done)(void))
+{
+    lcd_dma_sync();
+    LCD_STATS_ADD(commands, cmd_size);
+    LCD_STATS_ADD(databytes, n * 2);
+    lcd_dc_lo();
+    lcd_cs_lo();
+    if (cmd_size > 0)
+	spi_write_blocking(SPICH, cmd, cmd_size);
+    lcd_dc_hi();
+    spi_set_format(SPICH, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    spi16_pending = true;
+    if (n <= 0)
+    {
+      if (done)
+	done();
+      return;
+    }
+    dma_done = done;
+    dma_channel_set_irq0_enabled(spi_dma, done != NULL);
+    dma_channel_configure(spi_dma, &send16_config,
+           &spi_get_hw(SPICH)->dr,
+           px,
+           n,
+           true);
+}
+
 uint8_t touch_read_irq()
 {
   return (uint8_t) gpio_get(TOUCH_IRQ);
@@ -5,6 +5,10 @@
 #include "LCDdriver.h"
 #include "graphlib.h"
 #include "gamepad.h"
+#include "soundengine.h"
+#include "renderlist.h"
+#include "tilemap.h"
+#include "fixedpoint.h"
 
 #define	KEYUP	 VBMASK_UP
 #define	KEYDOWN	 VBMASK_DOWN
@@ -15,7 +19,7 @@
 
 PADEVENT *get_pad_event();
 
-#define clearscreen() LCD_Clear(0)
+#define clearscreen() clear_graphic()
 
 #define	PWM_WRAP (SYS_CLK_HZ/31250)
 
@@ -25,14 +29,35 @@ int apds_init();
 void sound_on(uint16_t f);
 void sound_off(void);
 void lcd_port_init();
+void padevent_init();
 uint32_t get_pad_vmask();
 void wait60thsec(unsigned short n);
+void frame_reset();
+
+/* Frame scheduler statistics, times are in us */
+typedef struct {
+  uint32_t frames;	/* calls of wait60thsec() */
+  uint32_t overruns;	/* frames which ended after their deadline */
+  uint32_t dropped;	/* ticks dropped when too far behind */
+  uint32_t work_max;	/* longest time from frame start to wait60thsec() */
+  uint32_t late_max;	/* longest wake up delay after deadline */
+  uint64_t work_total;	/* sum of work time */
+  uint64_t budget_total;	/* sum of frame time allowed */
+} FRAMESTATS;
+
+void get_frame_stats(FRAMESTATS *st);
 void set_font_data(const unsigned char *ptr);
 int check_pad_connect();
 uint8_t touch_read_irq();
 void touch_cs(int val);
 uint8_t touch_xchg_byte(uint8_t val);
 void lcd_send_data(const uint8_t *cmd, int cmd_size, uint8_t *bp, int dlen);
+void lcd_dma_write(const uint8_t *bp, int dlen);
+void lcd_dma_wait();
+void lcd_dma_fill(uint16_t color, int n);
+void lcd_dma_write16(const uint16_t *px, int n);
+void lcd_send_data16(const uint8_t *cmd, int cmd_size, const uint16_t *px, int n, void (*done)(void));
+void lcd_dma_sync();
 
 /* Entry for each games */
 void inv_main(void);
@@ -0,0 +1,429 @@
+/*
+ * Pico Games
+ *
+ * Recorded graphlib drawing commands
+ *
+ * graphlib asks render_recording() at the start of each drawing call.
+ * When it is true the call is passed to render_put() as a command, and
+ * render_exec() in graphlib runs it later.
+ *
+ * Display list
+ *
+ * Commands are appended to the arena of the list being recorded. When
+ * the arena is full, recorded commands are replayed and the list starts
+ * again, so drawing is never lost. dl_optimize() removes commands whose
+ * whole area is painted over by a later opaque command, and merges
+ * fills of adjacent areas which follow each other. Commands between
+ * RC_COMPOSE and RC_COMPOSE_END draw into the compose buffer, so only
+ * RC_COMPOSE_END paints over commands outside of it.
+ *
+ * Render worker
+ *
+ * Commands are kept in a single producer, single consumer ring. The
+ * game on core1 puts them, the worker on core0 takes and runs them.
+ * Each command has a sequence number, a fence is the number of the
+ * last command put, and render_wait() returns when the worker has run
+ * the commands up to it.
+ *
+ * The worker is started by the kick function set from core0, which
+ * wakes up its run loop. Without it, as in the host build or gesture
+ * mode, the kick runs the commands at once on the calling core.
+ */
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "picogames.h"
+#include "renderlist.h"
+#include "latency.h"
+
+#define	DL_LOOKAHEAD	64	/* commands searched for painting over */
+
+static DISPLAYLIST *dl_current;	/* list being recorded */
+static int dl_core;		/* core recording the list */
+
+#ifdef RENDER_WORKER
+
+#ifndef RENDER_DEPTH
+#define	RENDER_DEPTH	256	/* must be a power of 2 */
+#endif
+
+static RENDER_CMD render_ring[RENDER_DEPTH];
+static volatile uint32_t render_head;	/* commands put */
+static volatile uint32_t render_tail;	/* commands run */
+static volatile int render_active;
+static volatile int render_core = -1;	/* core running commands, -1 if none */
+static uint32_t frame_fence;		/* fence of previous frame */
+static void (*render_kick_func)(void);
+
+static void render_kick(void)
+{
+  if (render_kick_func)
+    (*render_kick_func)();
+  else
+    render_worker();
+}
+
+/*
+ * Record drawing calls from now, called by a game after its LCD setup.
+ */
+void render_start()
+{
+  frame_fence = render_head;
+  render_active = 1;
+}
+
+/*
+ * Run all recorded commands and draw directly again.
+ */
+void render_stop()
+{
+  render_sync();
+  render_active = 0;
+}
+
+static void render_ring_put(const RENDER_CMD *cmd)
+{
+  while (render_head - render_tail == RENDER_DEPTH)
+  {
+    render_kick();
+    tight_loop_contents();
+  }
+  render_ring[render_head & (RENDER_DEPTH - 1)] = *cmd;
+  __mem_fence_release();
+  render_head++;
+}
+
+uint32_t render_fence()
+{
+  return render_head;
+}
+
+void render_wait(uint32_t fence)
+{
+  if ((int32_t)(render_tail - fence) >= 0)
+    return;
+  render_kick();
+  while ((int32_t)(render_tail - fence) < 0)
+    tight_loop_contents();
+}
+
+void render_sync()
+{
+  render_wait(render_head);
+}
+
+/*
+ * End of frame, start drawing it and wait until the previous frame is
+ * drawn, so the game runs at most one frame ahead of the LCD.
+ */
+void render_frame()
+{
+  uint32_t fence;
+
+  if (!render_active)
+    return;
+  fence = render_fence();
+  latency_frame_fence(fence);
+  render_kick();
+  render_wait(frame_fence);
+  frame_fence = fence;
+}
+
+/*
+ * Run commands until the ring is empty.
+ */
+void render_worker()
+{
+  RENDER_CMD cmd;
+
+  render_core = get_core_num();
+  latency_render_done(render_tail);	/* frame may be run already */
+  while (render_tail != render_head)
+  {
+    __mem_fence_acquire();
+    cmd = render_ring[render_tail & (RENDER_DEPTH - 1)];
+    render_exec(&cmd);
+    __mem_fence_release();
+    render_tail++;
+    latency_render_done(render_tail);
+  }
+  render_core = -1;
+}
+
+void render_set_kick(void (*kick)(void))
+{
+  render_kick_func = kick;
+}
+
+#endif
+
+/*
+ * True if a drawing call should be recorded, false on the core running
+ * the commands.
+ */
+int render_recording()
+{
+  int core = get_core_num();
+
+#ifdef RENDER_WORKER
+  if (render_core == core)
+    return 0;
+  if (dl_current && dl_core == core)
+    return 1;
+  return render_active;
+#else
+  return dl_current && dl_core == core;
+#endif
+}
+
+void render_put(const RENDER_CMD *cmd)
+{
+  DISPLAYLIST *dl = dl_current;
+
+  if (dl && dl_core == (int)get_core_num())
+  {
+    if (dl->count == dl->size)
+    {
+      dl_replay(dl);
+      dl->count = 0;
+    }
+    dl->cmd[dl->count++] = *cmd;
+    return;
+  }
+#ifdef RENDER_WORKER
+  render_ring_put(cmd);
+#endif
+}
+
+/*
+ * Display list
+ */
+void dl_init(DISPLAYLIST *dl, RENDER_CMD *arena, int size)
+{
+  dl->cmd = arena;
+  dl->size = size;
+  dl->count = 0;
+}
+
+/*
+ * Record drawing calls of this core into dl, after ones already in it.
+ */
+void dl_begin(DISPLAYLIST *dl)
+{
+  dl_core = get_core_num();
+  dl_current = dl;
+}
+
+void dl_end()
+{
+  dl_current = NULL;
+}
+
+/*
+ * Run commands of dl. They go to the render worker if it is recording,
+ * otherwise to the frame buffer or LCD.
+ */
+void dl_replay(const DISPLAYLIST *dl)
+{
+  DISPLAYLIST *save = dl_current;
+  int i;
+
+  dl_current = NULL;
+  for (i = 0; i < dl->count; i++)
+    render_exec(&dl->cmd[i]);
+  dl_current = save;
+}
+
+typedef struct {
+  int x1, y1, x2, y2;		/* x2 and y2 are exclusive */
+} DL_RECT;
+
+/*
+ * Area a command may change, 0 if it draws nothing.
+ */
+static int cmd_rect(const RENDER_CMD *r, DL_RECT *q)
+{
+  const SPRITE *s;
+
+  switch (r->op)
+  {
+  case RC_CLEAR:
+    q->x1 = 0;
+    q->y1 = 0;
+    q->x2 = X_RES;
+    q->y2 = Y_RES;
+    return 1;
+  case RC_PSET:
+    q->x1 = r->x;
+    q->y1 = r->y;
+    q->x2 = r->x + 1;
+    q->y2 = r->y + 1;
+    return 1;
+  case RC_BMP:
+  case RC_CLRBMP:
+    q->x1 = r->x;
+    q->y1 = r->y;
+    q->x2 = r->x + r->a;
+    q->y2 = r->y + r->b;
+    return 1;
+  case RC_SPRITE:
+    s = r->p;
+    q->x1 = r->x;
+    q->y1 = r->y;
+    q->x2 = r->x + s->m;
+    q->y2 = r->y + s->n;
+    return 1;
+  case RC_HLINE:
+    q->x1 = r->x;
+    q->y1 = r->y;
+    q->x2 = r->w + 1;
+    q->y2 = r->y + 1;
+    return 1;
+  case RC_BOXFILL:
+    q->x1 = r->x;
+    q->y1 = r->y;
+    q->x2 = r->w + 1;
+    q->y2 = r->h + 1;
+    return 1;
+  case RC_FONT:
+    q->x1 = r->x;
+    q->y1 = r->y;
+    q->x2 = r->x + 8;
+    q->y2 = r->y + 8;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/*
+ * True if a command paints every dot of its area.
+ */
+static int cmd_opaque(const RENDER_CMD *r)
+{
+  switch (r->op)
+  {
+  case RC_CLEAR:
+  case RC_PSET:
+  case RC_CLRBMP:
+  case RC_HLINE:
+  case RC_BOXFILL:
+    return 1;
+  case RC_FONT:
+    return r->bc >= 0;
+  default:
+    return 0;
+  }
+}
+
+static int rect_covers(const DL_RECT *a, const DL_RECT *b)
+{
+  return a->x1 <= b->x1 && a->y1 <= b->y1 && a->x2 >= b->x2 && a->y2 >= b->y2;
+}
+
+/*
+ * Merge fill q following fill p into p, if their areas are adjacent
+ * and make a rectangle.
+ */
+static int merge_fill(RENDER_CMD *p, const RENDER_CMD *q)
+{
+  if (p->op != q->op)
+    return 0;
+  if (p->op == RC_CLRBMP)
+  {
+    if (p->y == q->y && p->b == q->b && p->x + p->a == q->x && p->a + q->a <= 255)
+    {
+      p->a += q->a;
+      return 1;
+    }
+    if (p->x == q->x && p->a == q->a && p->y + p->b == q->y && p->b + q->b <= 255)
+    {
+      p->b += q->b;
+      return 1;
+    }
+  }
+  else if (p->op == RC_BOXFILL && p->c == q->c)
+  {
+    if (p->y == q->y && p->h == q->h && p->w + 1 == q->x)
+    {
+      p->w = q->w;
+      return 1;
+    }
+    if (p->x == q->x && p->w == q->w && p->h + 1 == q->y)
+    {
+      p->h = q->h;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * True if command i is painted over by a later opaque command.
+ */
+static int painted_over(const DISPLAYLIST *dl, int i, int compose)
+{
+  const RENDER_CMD *r;
+  DL_RECT a, b;
+  int j, end, skip, have_compose;
+
+  if (!cmd_rect(&dl->cmd[i], &a))
+    return 0;
+  end = i + 1 + DL_LOOKAHEAD;
+  if (end > dl->count)
+    end = dl->count;
+  skip = 0;
+  have_compose = 0;
+  for (j = i + 1; j < end; j++)
+  {
+    r = &dl->cmd[j];
+    if (r->op == RC_COMPOSE)
+    {
+      if (compose)
+        return 0;
+      b.x1 = r->x;
+      b.y1 = r->y;
+      b.x2 = r->w + 1;
+      b.y2 = r->h + 1;
+      skip = 1;		/* draws into the compose buffer */
+      have_compose = 1;
+      continue;
+    }
+    if (r->op == RC_COMPOSE_END)
+    {
+      /*
+       * Without RC_COMPOSE, the list was replayed in the middle of a
+       * compose block and its area is not known.
+       */
+      if (compose || !have_compose)
+        return 0;
+      skip = 0;
+      if (rect_covers(&b, &a))
+        return 1;	/* whole compose area is sent */
+      continue;
+    }
+    if (!skip && cmd_opaque(r) && cmd_rect(r, &b) && rect_covers(&b, &a))
+      return 1;
+  }
+  return 0;
+}
+
+void dl_optimize(DISPLAYLIST *dl)
+{
+  int i, n, compose;
+
+  n = 0;
+  compose = 0;
+  for (i = 0; i < dl->count; i++)
+  {
+    if (dl->cmd[i].op == RC_COMPOSE)
+      compose = 1;
+    else if (dl->cmd[i].op == RC_COMPOSE_END)
+      compose = 0;
+    else if (painted_over(dl, i, compose))
+      continue;
+    if (n > 0 && merge_fill(&dl->cmd[n - 1], &dl->cmd[i]))
+      continue;
+    dl->cmd[n++] = dl->cmd[i];
+  }
+  dl->count = n;
+}
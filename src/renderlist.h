@@ -0,0 +1,80 @@
+/*
+ * Pico Games
+ *
+ * Recorded graphlib drawing commands.
+ *
+ * Display list: graphlib drawing calls are appended to a list in a
+ * caller supplied arena between dl_begin() and dl_end(). The list can
+ * be optimised and replayed later. Drawing is not on LCD until then, so
+ * getColor() must not be used while recording.
+ *
+ * Render worker, enabled by RENDER_WORKER: while a game has started
+ * the render list, graphlib drawing calls are recorded as commands
+ * instead of being sent to LCD. The worker runs the commands on core0,
+ * so LCD transfer of a frame overlaps the game logic of the next frame
+ * on core1.
+ */
+#ifndef RENDERLIST_H
+#define RENDERLIST_H
+
+#include <stdint.h>
+
+#if defined(RENDER_WORKER) && defined(USE_FRAMEBUFFER)
+#undef RENDER_WORKER	/* frame buffer is already sent by DMA in background */
+#endif
+
+typedef enum {
+  RC_PALETTE,		/* set_palette(x, a, b, c) */
+  RC_CLEAR,		/* clear_graphic() */
+  RC_PSET,		/* pset(x, y, c) */
+  RC_BMP,		/* putbmpmn2(x, y, a, b, p, bc) */
+  RC_SPRITE,		/* putsprite_clip(x, y, p, bc, w, h) */
+  RC_CLRBMP,		/* clrbmpmn(x, y, a, b) */
+  RC_HLINE,		/* hline(x, w, y, c) */
+  RC_BOXFILL,		/* boxfill(x, y, w, h, c) */
+  RC_FONT,		/* putfont(x, y, c, bc, a) */
+  RC_COMPOSE,		/* compose_begin(x, y, w, h) */
+  RC_COMPOSE_END,	/* compose_end() */
+} RENDER_OP;
+
+typedef struct {
+  uint8_t op;
+  uint8_t a, b, c;
+  int16_t x, y, w, h;
+  int16_t bc;
+  const void *p;
+} RENDER_CMD;
+
+typedef struct {
+  RENDER_CMD *cmd;	/* arena */
+  int size;		/* arena size in commands */
+  int count;		/* commands recorded */
+} DISPLAYLIST;
+
+void dl_init(DISPLAYLIST *dl, RENDER_CMD *arena, int size);
+void dl_begin(DISPLAYLIST *dl);
+void dl_end(void);
+void dl_optimize(DISPLAYLIST *dl);
+void dl_replay(const DISPLAYLIST *dl);
+
+int render_recording(void);
+void render_put(const RENDER_CMD *cmd);
+void render_exec(const RENDER_CMD *cmd);
+
+#ifdef RENDER_WORKER
+void render_start(void);
+void render_stop(void);
+uint32_t render_fence(void);
+void render_wait(uint32_t fence);
+void render_sync(void);
+void render_frame(void);
+void render_worker(void);
+void render_set_kick(void (*kick)(void));
+#else
+#define render_start() ((void)0)
+#define render_stop() ((void)0)
+#define render_sync() ((void)0)
+#define render_frame() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Pico Games
+ *
+ * Sound engine
+ *
+ * All channels are stepped by a repeating timer at 60Hz, and the
+ * highest numbered channel which is sounding drives the PWM through
+ * sound_on()/sound_off(). Games only start and stop channels.
+ * While no channel is playing the engine leaves the PWM alone, so games
+ * may still call sound_on()/sound_off() directly.
+ * With SOUND_MIXER each channel drives its own mixer voice instead.
+ *
+ * The timer runs on core0 and games on core1, channel state is shared
+ * under a critical section. Step functions of games run under it too,
+ * and games take it by sound_update_begin() to change variables which
+ * the step functions also change, such as the position in an effect.
+ */
+#include "pico/stdlib.h"
+#include "pico/critical_section.h"
+#include "picogames.h"
+#include "soundengine.h"
+
+#define	SOUND_HZ	60
+
+typedef enum {
+  VOICE_IDLE,
+  VOICE_MUSIC,
+  VOICE_TONES,
+  VOICE_STEP,
+  VOICE_SAMPLE,
+} VOICE_TYPE;
+
+typedef struct {
+  VOICE_TYPE type;
+  unsigned short count;		/* ticks left of current note */
+  unsigned short loop;		/* repeats left of tone list */
+  int pr;			/* period of current note */
+  const unsigned char *m, *mstart;	/* musicdata position and repeat point */
+  const unsigned short *table;	/* period table of musicdata */
+  const unsigned int *t, *tstart;	/* tone list position and start */
+  SOUND_STEP step;
+} SOUND_VOICE;
+
+static SOUND_VOICE voices[SOUND_CHANNELS];
+static critical_section_t sound_lock;
+static repeating_timer_t sound_timer;
+static int sound_out = SOUND_END;	/* period on PWM, SOUND_END if not driven by engine */
+
+static int music_step(SOUND_VOICE *v)
+{
+  if (--v->count > 0)
+    return v->pr;
+  if (*v->m == 254)
+    return SOUND_END;
+  if (*v->m == 253)
+    v->m = v->mstart;
+  if (*v->m == 255)
+    v->pr = SOUND_REST;
+  else
+    v->pr = v->table[*v->m];
+  v->count = v->m[1];
+  v->m += 2;
+  return v->pr;
+}
+
+static int tones_step(SOUND_VOICE *v)
+{
+  if (--v->count > 0)
+    return v->pr;
+  if (*v->t < 0x10000)
+  {
+    if (--v->loop == 0)
+      return SOUND_END;
+    v->t = v->tstart;
+  }
+  v->count = *v->t >> 16;
+  v->pr = *v->t & 0xffff;
+  v->t++;
+  return v->pr;
+}
+
+static bool sound_timer_callback(repeating_timer_t *rt)
+{
+  SOUND_VOICE *v;
+  int ch, r, out, active;
+
+  critical_section_enter_blocking(&sound_lock);
+  active = 0;
+  out = SOUND_REST;
+  for (ch = 0; ch < SOUND_CHANNELS; ch++)
+  {
+    v = &voices[ch];
+    switch (v->type)
+    {
+    case VOICE_MUSIC:
+      r = music_step(v);
+      break;
+    case VOICE_TONES:
+      r = tones_step(v);
+      break;
+    case VOICE_STEP:
+      r = (*v->step)();
+      break;
+#ifdef SOUND_MIXER
+    case VOICE_SAMPLE:
+      if (!mixer_sample_playing(ch))
+        v->type = VOICE_IDLE;
+      continue;
+#endif
+    default:
+      continue;
+    }
+    if (r == SOUND_END)
+    {
+      v->type = VOICE_IDLE;
+#ifdef SOUND_MIXER
+      mixer_period(ch, SOUND_END);
+#endif
+      continue;
+    }
+#ifdef SOUND_MIXER
+    mixer_period(ch, r);
+    continue;
+#endif
+    active = 1;
+    if (r != SOUND_SKIP)
+      out = r;
+  }
+  if (!active)
+  {
+    if (sound_out != SOUND_END)
+    {
+      sound_off();
+      sound_out = SOUND_END;
+    }
+  }
+  else if (out != sound_out)
+  {
+    if (out >= 0)
+      sound_on(out);
+    else
+      sound_off();
+    sound_out = out;
+  }
+  critical_section_exit(&sound_lock);
+  return true;
+}
+
+void sound_engine_init(unsigned int slice)
+{
+  critical_section_init(&sound_lock);
+#ifdef SOUND_MIXER
+  mixer_init(slice);
+#endif
+  add_repeating_timer_us(-1000000 / SOUND_HZ, sound_timer_callback, NULL, &sound_timer);
+}
+
+/*
+ * Start musicdata m on channel ch, the first note sounds at next tick.
+ */
+void sound_music(SOUND_CHANNEL ch, const unsigned char *m, const unsigned short *table)
+{
+  SOUND_VOICE *v = &voices[ch];
+
+  critical_section_enter_blocking(&sound_lock);
+  v->m = m;
+  v->mstart = m;
+  v->table = table;
+  v->count = 1;
+  v->type = VOICE_MUSIC;
+  critical_section_exit(&sound_lock);
+}
+
+/*
+ * Start tone list s on channel ch.
+ */
+void sound_tones(SOUND_CHANNEL ch, const unsigned int *s)
+{
+  SOUND_VOICE *v = &voices[ch];
+  const unsigned int *p;
+
+  for (p = s; *p >= 0x10000; p++)
+    ;
+  critical_section_enter_blocking(&sound_lock);
+  v->t = s;
+  v->tstart = s;
+  v->loop = *p;
+  v->count = 1;
+  v->type = VOICE_TONES;
+  critical_section_exit(&sound_lock);
+}
+
+/*
+ * Let step() decide the sound of channel ch every tick, until it
+ * returns SOUND_END or the channel is stopped.
+ */
+void sound_step(SOUND_CHANNEL ch, SOUND_STEP step)
+{
+  SOUND_VOICE *v = &voices[ch];
+
+  critical_section_enter_blocking(&sound_lock);
+  v->step = step;
+  v->type = VOICE_STEP;
+  critical_section_exit(&sound_lock);
+}
+
+void sound_update_begin()
+{
+  critical_section_enter_blocking(&sound_lock);
+}
+
+void sound_update_end()
+{
+  critical_section_exit(&sound_lock);
+}
+
+/*
+ * Stop channel ch, the sound changes at next tick.
+ */
+void sound_stop(SOUND_CHANNEL ch)
+{
+  critical_section_enter_blocking(&sound_lock);
+  voices[ch].type = VOICE_IDLE;
+  critical_section_exit(&sound_lock);
+#ifdef SOUND_MIXER
+  mixer_period(ch, SOUND_END);
+  mixer_sample(ch, NULL, 0, 0);
+#endif
+}
+
+/*
+ * Stop all channels and silence at once.
+ */
+void sound_stop_all()
+{
+  int ch;
+
+  critical_section_enter_blocking(&sound_lock);
+  for (ch = 0; ch < SOUND_CHANNELS; ch++)
+    voices[ch].type = VOICE_IDLE;
+  sound_off();
+  sound_out = SOUND_END;
+  critical_section_exit(&sound_lock);
+#ifdef SOUND_MIXER
+  for (ch = 0; ch < SOUND_CHANNELS; ch++)
+  {
+    mixer_period(ch, SOUND_END);
+    mixer_sample(ch, NULL, 0, 0);
+  }
+#endif
+}
+
+int sound_playing(SOUND_CHANNEL ch)
+{
+  return voices[ch].type != VOICE_IDLE;
+}
+
+#ifdef SOUND_MIXER
+/*
+ * Select waveform of channel ch for following notes.
+ */
+void sound_wave(SOUND_CHANNEL ch, SOUND_WAVE wave, const signed char *table)
+{
+  mixer_wave(ch, wave, table);
+}
+
+/*
+ * Play 8bit signed PCM sample once on channel ch, instead of its notes.
+ */
+void sound_sample(SOUND_CHANNEL ch, const signed char *pcm, unsigned int len, unsigned int rate)
+{
+  mixer_sample(ch, pcm, len, rate);
+  critical_section_enter_blocking(&sound_lock);
+  voices[ch].type = VOICE_SAMPLE;
+  critical_section_exit(&sound_lock);
+}
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Pico Games
+ *
+ * Sound engine, plays background music and sound effects from a
+ * repeating timer so that slow frames do not disturb them.
+ */
+#ifndef SOUNDENGINE_H
+#define SOUNDENGINE_H
+
+/*
+ * Channels are stepped every 1/60 second. When more than one channel
+ * is sounding, the one with the larger number is heard, so effects
+ * override the music and resume it when they are done.
+ * With SOUND_MIXER every channel has its own voice and all are heard.
+ */
+typedef enum {
+  SOUND_MUSIC,		/* background music */
+  SOUND_EFFECT,		/* game sound effects */
+  SOUND_EFFECT2,	/* effects over SOUND_EFFECT */
+  SOUND_CHANNELS,
+} SOUND_CHANNEL;
+
+/*
+ * Values returned by a channel step, other values are periods for
+ * sound_on().
+ */
+#define	SOUND_SKIP	(-1)	/* silent in this tick, lower channel is heard */
+#define	SOUND_REST	(-2)	/* silent in this tick, lower channel is muted */
+#define	SOUND_END	(-3)	/* channel has finished */
+
+/*
+ * Step function of the user channel, called from the timer IRQ.
+ */
+typedef int (*SOUND_STEP)(void);
+
+void sound_engine_init(unsigned int slice);
+
+/*
+ * musicdata format: pairs of note and length in 1/60 second. Note is an
+ * index to the period table, 255 is a rest, 253 repeats from the start
+ * and 254 ends the music.
+ */
+void sound_music(SOUND_CHANNEL ch, const unsigned char *m, const unsigned short *table);
+
+/*
+ * Tone list format: (length in 1/60 second << 16 | period) entries,
+ * terminated by a repeat count below 0x10000.
+ */
+void sound_tones(SOUND_CHANNEL ch, const unsigned int *s);
+
+void sound_step(SOUND_CHANNEL ch, SOUND_STEP step);
+
+/*
+ * A step function runs in the timer on core0. A game changes variables
+ * which its step functions also change only between these, so that no
+ * step runs in the middle.
+ */
+void sound_update_begin(void);
+void sound_update_end(void);
+
+void sound_stop(SOUND_CHANNEL ch);
+void sound_stop_all(void);
+int sound_playing(SOUND_CHANNEL ch);
+
+#ifdef SOUND_MIXER
+/*
+ * Software mixer, voices are synthesised into PCM at the PWM wrap rate
+ * and sent to the PWM level by DMA. Voice n plays channel n, the last
+ * voice plays sound_on()/sound_off().
+ */
+#define	MIXER_VOICES	(SOUND_CHANNELS + 1)
+#define	MIXER_RATE	(SYS_CLK_HZ / PWM_WRAP)
+
+typedef enum {
+  SOUND_SQUARE,		/* default */
+  SOUND_NOISE,		/* LFSR clocked at the note frequency */
+  SOUND_WAVETABLE,	/* 32 samples per cycle */
+} SOUND_WAVE;
+
+void sound_wave(SOUND_CHANNEL ch, SOUND_WAVE wave, const signed char *table);
+void sound_sample(SOUND_CHANNEL ch, const signed char *pcm, unsigned int len, unsigned int rate);
+
+void mixer_init(unsigned int slice);
+void mixer_period(int voice, int period);
+void mixer_wave(int voice, SOUND_WAVE wave, const signed char *table);
+void mixer_sample(int voice, const signed char *pcm, unsigned int len, unsigned int rate);
+int mixer_sample_playing(int voice);
+#endif
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Pico Games
+ *
+ * Software sound mixer, enabled by SOUND_MIXER.
+ *
+ * PWM runs without clock divider and wraps at MIXER_RATE (31.25kHz).
+ * Two DMA channels paced by the wrap DREQ and chained to each other
+ * write PCM samples to the PWM level from two buffers. When one buffer
+ * has been sent, DMA_IRQ_0 mixes the voices into it again while the
+ * other one is playing.
+ *
+ * Voice settings are written by the sound engine and sound_on() under
+ * mixer_lock, the IRQ copies them before mixing a buffer.
+ */
+#include "pico/stdlib.h"
+#include "pico/critical_section.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "picogames.h"
+
+#ifdef SOUND_MIXER
+
+#define	MIXER_BUF	256	/* samples per DMA buffer, 8.2ms */
+#define	MIXER_VOLUME	64	/* amplitude of one voice in 8bit PCM */
+#define	MIXER_MIN_PERIOD	32	/* sound_on() period at half of MIXER_RATE */
+
+typedef struct {
+  SOUND_WAVE wave;
+  const signed char *table;	/* SOUND_WAVETABLE samples */
+  uint32_t inc;			/* phase step per output sample, 0 if silent */
+  const signed char *pcm;	/* sample being played, NULL if none */
+  uint32_t len;			/* sample length in 16.16 */
+  uint32_t rate;		/* sample position step in 16.16 */
+  uint32_t start;		/* incremented when a sample is started */
+} MIXER_VOICE;
+
+typedef struct {
+  uint32_t phase;		/* wave phase, or sample position in 16.16 */
+  uint32_t start;		/* sample start count being played */
+  uint16_t lfsr;
+} MIXER_STATE;
+
+static MIXER_VOICE voice[MIXER_VOICES];
+static MIXER_STATE state[MIXER_VOICES];
+static critical_section_t mixer_lock;
+static uint32_t mixer_buf[2][MIXER_BUF];
+static uint mixer_dma[2];
+static uint mixer_shift;	/* position of level in CC register */
+
+/*
+ * Mix all voices into 8bit PCM and convert to PWM level.
+ */
+static void mixer_fill(uint32_t *buf)
+{
+  MIXER_VOICE v[MIXER_VOICES];
+  MIXER_STATE *st;
+  int i, n, s;
+  uint32_t phase;
+
+  critical_section_enter_blocking(&mixer_lock);
+  for (n = 0; n < MIXER_VOICES; n++)
+  {
+    v[n] = voice[n];
+    if (v[n].pcm && state[n].start != v[n].start)
+    {
+      state[n].start = v[n].start;
+      state[n].phase = 0;
+    }
+  }
+  critical_section_exit(&mixer_lock);
+
+  for (i = 0; i < MIXER_BUF; i++)
+    buf[i] = 0;
+  for (n = 0; n < MIXER_VOICES; n++)
+  {
+    st = &state[n];
+    if (v[n].pcm)
+    {
+      for (i = 0; i < MIXER_BUF && st->phase < v[n].len; i++)
+      {
+        buf[i] += v[n].pcm[st->phase >> 16] / 2;
+        st->phase += v[n].rate;
+      }
+      if (st->phase >= v[n].len)
+      {
+        critical_section_enter_blocking(&mixer_lock);
+        if (voice[n].start == v[n].start)
+          voice[n].pcm = NULL;
+        critical_section_exit(&mixer_lock);
+      }
+      continue;
+    }
+    if (v[n].inc == 0)
+      continue;
+    for (i = 0; i < MIXER_BUF; i++)
+    {
+      phase = st->phase + v[n].inc;
+      switch (v[n].wave)
+      {
+      case SOUND_NOISE:
+        if (phase < st->phase)
+          st->lfsr = (st->lfsr >> 1) ^ (-(st->lfsr & 1) & 0xb400);
+        s = (st->lfsr & 1) ? MIXER_VOLUME : -MIXER_VOLUME;
+        break;
+      case SOUND_WAVETABLE:
+        s = v[n].table[phase >> 27] / 2;
+        break;
+      default:
+        s = (phase & 0x80000000) ? -MIXER_VOLUME : MIXER_VOLUME;
+        break;
+      }
+      st->phase = phase;
+      buf[i] += s;
+    }
+  }
+  for (i = 0; i < MIXER_BUF; i++)
+  {
+    s = (int32_t)buf[i];
+    if (s > 127)
+      s = 127;
+    else if (s < -128)
+      s = -128;
+    buf[i] = ((uint32_t)(s + 128) * PWM_WRAP >> 8) << mixer_shift;
+  }
+}
+
+static void mixer_dma_irq_handler(void)
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+  {
+    if (!dma_channel_get_irq0_status(mixer_dma[i]))
+      continue;
+    dma_channel_acknowledge_irq0(mixer_dma[i]);
+    dma_channel_set_read_addr(mixer_dma[i], mixer_buf[i], false);
+    mixer_fill(mixer_buf[i]);
+  }
+}
+
+void mixer_init(unsigned int slice)
+{
+  dma_channel_config c;
+  int i;
+
+  critical_section_init(&mixer_lock);
+  for (i = 0; i < MIXER_VOICES; i++)
+    state[i].lfsr = 1;
+  mixer_shift = (SOUND_CHAN == PWM_CHAN_B) ? 16 : 0;
+  mixer_fill(mixer_buf[0]);
+  mixer_fill(mixer_buf[1]);
+
+  pwm_set_clkdiv_int_frac(slice, 1, 0);
+  mixer_dma[0] = dma_claim_unused_channel(true);
+  mixer_dma[1] = dma_claim_unused_channel(true);
+  for (i = 0; i < 2; i++)
+  {
+    c = dma_channel_get_default_config(mixer_dma[i]);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pwm_get_dreq(slice));
+    channel_config_set_chain_to(&c, mixer_dma[i ^ 1]);
+    dma_channel_configure(mixer_dma[i], &c, &pwm_hw->slice[slice].cc,
+                          mixer_buf[i], MIXER_BUF, false);
+    dma_channel_set_irq0_enabled(mixer_dma[i], true);
+  }
+  irq_add_shared_handler(DMA_IRQ_0, mixer_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_0, true);
+  pwm_set_enabled(slice, true);
+  dma_channel_start(mixer_dma[0]);
+}
+
+/*
+ * Play square wave of sound_on() period on voice, or silence if the
+ * period is negative. PWM clock divider 0 means 256, so is period 0.
+ */
+void mixer_period(int n, int period)
+{
+  uint32_t inc;
+
+  if (period < 0)
+    inc = 0;
+  else
+  {
+    if (period == 0)
+      period = 256 * 16;
+    else if (period < MIXER_MIN_PERIOD)
+      period = MIXER_MIN_PERIOD;
+    inc = ((uint64_t)16 << 32) / period;
+  }
+  critical_section_enter_blocking(&mixer_lock);
+  voice[n].inc = inc;
+  critical_section_exit(&mixer_lock);
+}
+
+void mixer_wave(int n, SOUND_WAVE wave, const signed char *table)
+{
+  critical_section_enter_blocking(&mixer_lock);
+  voice[n].wave = wave;
+  voice[n].table = table;
+  critical_section_exit(&mixer_lock);
+}
+
+/*
+ * Play 8bit signed PCM sample once on voice, rate in Hz.
+ */
+void mixer_sample(int n, const signed char *pcm, unsigned int len, unsigned int rate)
+{
+  critical_section_enter_blocking(&mixer_lock);
+  voice[n].len = (uint32_t)len << 16;
+  voice[n].rate = ((uint64_t)rate << 16) / MIXER_RATE;
+  voice[n].start++;
+  voice[n].pcm = pcm;
+  critical_section_exit(&mixer_lock);
+}
+
+int mixer_sample_playing(int n)
+{
+  return voice[n].pcm != NULL;
+}
+
+#endif
@@ -3,19 +3,25 @@
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
 #include "hardware/spi.h"
-#include "pacman2.h"
 #include "picogames.h"
+#include "pacman2.h"
 
 extern const unsigned char PacFontData[];
 
 _Character pacman,akabei,pinky,aosuke,guzuta; //各キャラクターの構造体
-_Music music; //演奏中の音楽構造体
+static _Character * const chars[]={&pacman,&akabei,&pinky,&aosuke,&guzuta};
+static _Area oldarea[5]; //各キャラクターの移動前の表示範囲
+static unsigned char maptile[MAPXSIZE*MAPYSIZE],mapcolor[MAPXSIZE*MAPYSIZE]; //表示中のマップの文字コードとカラー
+static void drawmaptile(int x,int y,unsigned char tile,unsigned char color);
+static TILEMAP maplayer={0,0,MAPXSIZE,MAPYSIZE,MAPXSIZE,8,8,maptile,mapcolor,drawmaptile};
+static unsigned char cookieblink; //パワーえさを最後に表示したときのgamecount
+static unsigned char headless; //1:表示しないで実行（pacman_reset()で設定）
 static unsigned int score,highscore; //得点、ハイスコア
 unsigned char player; //パックマン残数
 static unsigned char stage; //現在のステージ数
 unsigned char gamecount; //全体カウンター
 static unsigned char gamestatus; //0:ゲームスタート、1:ゲーム中、2:プレイヤー1減、3:ステージクリア、4:ゲームオーバー
-unsigned short pacmanspeed,monsterspeed,ijikespeed,medamaspeed;//現在のステージの各キャラの移動速度（カウンタ）
+UFIX8 pacmanspeed,monsterspeed,ijikespeed,medamaspeed;//現在のステージの各キャラの移動速度（1フレームの移動ドット数、下位8ビットは小数点以下）
 unsigned short ijiketime; //現在のステージのイジケ時間
 unsigned char fruitno; //現在のステージのフルーツ番号
 unsigned char upflag; //10000点越えのプレイヤー増チェック
@@ -31,14 +37,21 @@ unsigned short monstersound,monstersounddif; //モンスター効果音の値と
 unsigned short monsterhuntedsound; //イジケ捕獲効果音の値
 unsigned short fruitsound; //フルーツ獲得効果音
 unsigned short firekeyold; //一時停止キー状態
-unsigned char map[MAPXSIZE*MAPYSIZE]; // 通路、壁、えさ、パワーえさ、フルーツ、ドアがあることを表す
+// マップのビットボード。1行を1ワードとし、ビットxがマスxを表す
+static uint32_t wallbits[MAPYSIZE]; // 壁
+static uint32_t cookiebits[MAPYSIZE]; // えさ
+static uint32_t powerbits[MAPYSIZE]; // パワーえさ
+static uint32_t doorbits[MAPYSIZE]; // ドア
+static unsigned char fruiton; // フルーツが出ているとき1
+static unsigned char mazeexit[2][MAPXSIZE*MAPYSIZE]; // 各マスからモンスターが進める方向（1<<DIR_xxの和）[0]:目玉以外、[1]:目玉
+static unsigned char homedir[MAPXSIZE*MAPYSIZE]; // 目玉がモンスターハウスへ最短で戻るための各マスでの方向、0xff:なし
 unsigned char fruit[]={0,1,2,2,3,3,4,4,5,5,6,6,7}; //面ごとのフルーツ番号
 unsigned short fruitscore[]={10,30,50,70,100,200,300,500}; //フルーツの得点
-unsigned short pacmansp[]= {135,150,150,150,160,160,160,170,170,170,190,190,190,210,210,210,210,256,256,256,256}; //面ごとのパックマン速度
-unsigned short monstersp[]={135,150,150,150,160,160,160,170,170,170,190,190,190,210,210,210,210,256,256,256,256}; //面ごとのモンスター速度
-unsigned short ijikesp[]=  { 50, 60, 60, 60, 65, 65, 65, 70, 70, 70, 75, 75, 75, 80, 80, 80, 80, 90, 90, 90, 90}; //面ごとのイジケ速度
+UFIX8 pacmansp[]=          {135,150,150,150,160,160,160,170,170,170,190,190,190,210,210,210,210,256,256,256,256}; //面ごとのパックマン速度
+UFIX8 monstersp[]=         {135,150,150,150,160,160,160,170,170,170,190,190,190,210,210,210,210,256,256,256,256}; //面ごとのモンスター速度
+UFIX8 ijikesp[]=           { 50, 60, 60, 60, 65, 65, 65, 70, 70, 70, 75, 75, 75, 80, 80, 80, 80, 90, 90, 90, 90}; //面ごとのイジケ速度
 unsigned short ijike[]=    {550,520,450,350,130,300,130,120, 60,300,100, 60, 60,180, 60, 60,  0 ,60,  0,  0,  0}; //面ごとのイジケ時間
-unsigned short medamasp[]= {512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512}; //面ごとの目玉速度
+UFIX8 medamasp[]=          {512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512,512}; //面ごとの目玉速度
 
 //sounddata配列　ド～上のド～その上のドの周期カウンタ値
 // 31250/(440*power(2,k/12))*16  kはラからの差分、低音にいくほどマイナス
@@ -92,57 +105,47 @@ unsigned char scenedata[MAPXSIZE*MAPYSIZE]={
 	0x82,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x84,0x83
 };
 
-//マクロ設定　仮想マップの読み出し、書き込み
-#define GETMAP(x,y) map[(y)*MAPXSIZE+(x)]
-#define SETMAP(x,y,d) map[(y)*MAPXSIZE+(x)]=(d)
+//マクロ設定　ビットボードの読み出し
+#define BIT(x) (1u<<(x))
+#define ISWALL(x,y) ((wallbits[y]>>(x))&1) //壁
+#define ISBLOCK(x,y) (((wallbits[y]|doorbits[y])>>(x))&1) //壁またはドア
+#define GETMAP(x,y) getmap(x,y)
+
+static unsigned char getmap(unsigned char x,unsigned char y){
+	//マス(x,y)の配置物（MAP_xx）をビットボードから求める。マップ外はMAP_NONE
+	uint32_t b;
+
+	if(x>=MAPXSIZE || y>=MAPYSIZE) return MAP_NONE;
+	b=BIT(x);
+	if(wallbits[y]&b) return MAP_WALL;
+	if(cookiebits[y]&b) return MAP_COOKIE;
+	if(powerbits[y]&b) return MAP_POWERCOOKIE;
+	if(doorbits[y]&b) return MAP_DOOR;
+	if(fruiton && x==FRUITX && y==FRUITY) return MAP_FRUIT;
+	return MAP_NONE;
+}
 
 unsigned char startkeycheck(unsigned short n){
 	// 60分のn秒ウェイト
 	// スタートボタンが押されればすぐ戻る
 	//　戻り値　スタートボタン押されれば1、押されなければ0
-	uint64_t t=to_us_since_boot(get_absolute_time())%16667;
-
-    PADEVENT *pevent;
-
-    while(n--) {
-        sleep_us(16667-t);
-     
-        if (get_pad_vmask() == KEYSTART)
-          return 1;
-        t=0;
-    }
+	while(n--){
+		wait60thsec(1);
+		if (get_pad_vmask() == KEYSTART)
+			return 1;
+	}
 	return 0;
 }
-void playmusic60thsec(void){
-	//60分の1秒ウェイト後、現在演奏中の曲を1つ進める
-	wait60thsec(1); //60分の1秒ウェイト
-	if(music.stop) return; //演奏終了済み
-	music.count--;
-	if(music.count>0) return;
-
-	//次の音を鳴らす
-	if(*music.p==254){ //曲終了
-		music.stop=1;
-		sound_off();
-		return;
-	}
-	if(*music.p==255) sound_off(); //休符
-	else sound_on(sounddata[*music.p]); //周期データ
-	music.p++;
-	music.count=*music.p; //音符長さ
-	music.p++;
-}
 void startmusic(unsigned char *m){
-	music.p=m;
-	music.count=1;
-	music.stop=0;
+	//曲の演奏開始、以後はサウンドエンジンがタイマー割り込みで演奏
+	sound_music(SOUND_MUSIC,m,sounddata);
 }
 /*
 //　単に曲演奏　（今回は未使用）
 void playmusic(unsigned char *m){
 	startmusic(m);
-	while(music.stop==0){
-		playmusic60thsec();
+	while(sound_playing(SOUND_MUSIC)){
+		wait60thsec(1);
 	}
 }	
 */
@@ -166,77 +169,27 @@ static void printscore(unsigned char x,unsigned char y,unsigned char c,unsigned
 	}while(s!=0);
 }
 
-void putbmpmn3(int x,int y,unsigned char m,unsigned char n,const unsigned char bmp[])
-// 横m*縦nドットのキャラクターを座標x,yに表示
-// ゲームのマップ内だけに描画の場合はこちら（マップ外にはみ出した部分は表示しない）
-// unsigned char bmp[m*n]配列に、単純にカラー番号を並べる
-// カラー番号が0の部分は透明色として扱う
-{
-	int i,j;
-	int skip;
-	static uint8_t lcddatabuf[64];
-	uint8_t *lcdbufp;
-	const unsigned char *p;
-	if(x<=-m || x>=MAPXSIZE*8 || y<=-n || y>=MAPYSIZE*8) return; //画面外
-	if(y<0){ //画面上部に切れる場合
-		i=0;
-		p=bmp-y*m;
-	}
-	else{
-		i=y;
-		p=bmp;
-	}
-	for(;i<y+n;i++){
-		if(i>=MAPYSIZE*8) return; //画面下部に切れる場合
-		if(x<0){ //画面左に切れる場合は残る部分のみ描画
-			j=0;
-			p+=-x;
-		}
-		else{
-			j=x;
-		}
-		skip=1;
-		lcdbufp=lcddatabuf;
-		for(;j<x+m;j++){
-			if(j>=MAPXSIZE*8){ //画面右に切れる場合
-				p+=x+m-j;
-				break;
-			}
-			if(*p!=0){ //カラー番号が0の場合、透明として処理
-				if(skip){
-					LCD_SetCursor(j,i);
-					skip=0;
-				}
-				*lcdbufp++=palette[*p]>>8;
-				*lcdbufp++=(uint8_t)palette[*p];
-			}
-			else{
-				skip=1;
-				if(lcdbufp!=lcddatabuf){
-					LCD_WriteDataN(lcddatabuf,lcdbufp-lcddatabuf);
-					lcdbufp=lcddatabuf;
-				}
-			}
-			p++;
-		}
-		if(lcdbufp!=lcddatabuf){
-			LCD_WriteDataN(lcddatabuf,lcdbufp-lcddatabuf);
-		}
-	}
-}
-void putpacman(void){
-	//パックマンの表示
-	unsigned char a;
+static void animpacman(void){
+	//パックマンのアニメーション値更新
 	pacman.animcount--;
 	if(pacman.animcount==0){
 		pacman.animcount=pacman.animcount0;
 		pacman.animvalue++;
 		if(pacman.animvalue==6) pacman.animvalue=0;
 	}
+}
+static void drawpacman(void){
+	//パックマンを現在のアニメーション値で表示
+	unsigned char a;
 	if(pacman.animvalue==0) a=0;
 	else if(pacman.animvalue<=3) a=pacman.dir*3+pacman.animvalue;
 	else a=pacman.dir*3+6-pacman.animvalue;
-	putbmpmn3((int)(pacman.x/256)-3,(int)(pacman.y/256)-3,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[a]);
+	putspriteclip((int)FIX_INT(pacman.x)-3,(int)FIX_INT(pacman.y)-3,&Pacmanspr[a],MAPXSIZE*8,MAPYSIZE*8);
+}
+void putpacman(void){
+	//パックマンの表示
+	animpacman();
+	drawpacman();
 }
 void putmonster(_Character *p){
 	//モンスター表示　p:キャラクターのポインタ指定
@@ -246,16 +199,16 @@ void putmonster(_Character *p){
 	switch(p->status){
 		case IJIKE:
 			if(p->modecount>180 || gamecount & 8)
-				putbmpmn3((int)(p->x/256)-3,(int)(p->y/256)-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Ijikebmp[i]);
+				putspriteclip((int)FIX_INT(p->x)-3,(int)FIX_INT(p->y)-3,&Ijikespr[i],MAPXSIZE*8,MAPYSIZE*8);
 			else
 				//白で点滅
-				putbmpmn3((int)(p->x/256)-3,(int)(p->y/256)-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Ijikebmp[2+i]);
+				putspriteclip((int)FIX_INT(p->x)-3,(int)FIX_INT(p->y)-3,&Ijikespr[2+i],MAPXSIZE*8,MAPYSIZE*8);
 			break;
 		case MEDAMA:
-			putbmpmn3((int)(p->x/256)-3,(int)(p->y/256)-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Medamabmp[p->dir]);
+			putspriteclip((int)FIX_INT(p->x)-3,(int)FIX_INT(p->y)-3,&Medamaspr[p->dir],MAPXSIZE*8,MAPYSIZE*8);
 			break;
 		default:
-			putbmpmn3((int)(p->x/256)-3,(int)(p->y/256)-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[p->no*8+p->dir*2+i]);
+			putspriteclip((int)FIX_INT(p->x)-3,(int)FIX_INT(p->y)-3,&Monsterspr[p->no*8+p->dir*2+i],MAPXSIZE*8,MAPYSIZE*8);
 	}
 }
 void blinkpowercookie(){
@@ -274,35 +227,50 @@ unsigned char getfruitno(unsigned char s){
 }
 void putfruit(void){
 	// フルーツ表示
-	putbmpmn3(FRUITX*8-2,FRUITY*8-3,12,14,Fruitbmp[fruitno]);
+	putspriteclip(FRUITX*8-2,FRUITY*8-3,&Fruitspr[fruitno],MAPXSIZE*8,MAPYSIZE*8);
 }
-void putmapchar(unsigned char x,unsigned char y){
-	//マップ上のコードに応じたものを表示
+static void drawmaptile(int x,int y,unsigned char tile,unsigned char color){
+	//タイルマップから呼ばれ、ドット座標(x,y)に1文字表示
+	putfont(x,y,color,0,tile);
+}
+static void setmaptile(unsigned char x,unsigned char y){
+	//マップ上のコードに応じた文字をタイルマップに書き込む。変化したら次のtilemap_flush()で表示
 	unsigned char d;
 
 	d=GETMAP(x,y);
-	if(d==MAP_COOKIE) printchar(x,y,COLOR_COOKIE,CODE_COOKIE);
-	else if(d==MAP_POWERCOOKIE) printchar(x,y,COLOR_POWERCOOKIE,CODE_POWERCOOKIE);
-	else if(d==MAP_DOOR) printchar(x,y,COLOR_DOOR,CODE_DOOR);
-	else if(d==MAP_WALL) printchar(x,y,COLOR_WALL,scenedata[y*MAPXSIZE+x]);
-	else printchar(x,y,0,' ');
+	if(d==MAP_COOKIE) tilemap_put(&maplayer,x,y,CODE_COOKIE,COLOR_COOKIE);
+	else if(d==MAP_POWERCOOKIE) tilemap_put(&maplayer,x,y,CODE_POWERCOOKIE,COLOR_POWERCOOKIE);
+	else if(d==MAP_DOOR) tilemap_put(&maplayer,x,y,CODE_DOOR,COLOR_DOOR);
+	else if(d==MAP_WALL) tilemap_put(&maplayer,x,y,scenedata[y*MAPXSIZE+x],COLOR_WALL);
+	else tilemap_put(&maplayer,x,y,' ',0);
+}
+void putmapchar(unsigned char x,unsigned char y){
+	//マップ上のコードに応じたものをすぐに表示
+	setmaptile(x,y);
+	tilemap_draw(&maplayer,x,y);
+}
+static void dirtymapchar(unsigned char x,unsigned char y){
+	//マップ上のコードに応じたものを次のtilemap_flush()で表示
+	setmaptile(x,y);
+	tilemap_dirty(&maplayer,x,y);
 }
 void setfruit(unsigned char f){
 	// f 0:フルーツ削除&表示消去、1:フルーツ発生&表示
 	if(f){
-		SETMAP(FRUITX,FRUITY,MAP_FRUIT);
+		fruiton=1;
 	}
 	else{
-		SETMAP(FRUITX,FRUITY,MAP_NONE);
-		putmapchar(FRUITX-1,FRUITY-1);
-		putmapchar(FRUITX  ,FRUITY-1);
-		putmapchar(FRUITX+1,FRUITY-1);
-		putmapchar(FRUITX-1,FRUITY  );
-		putmapchar(FRUITX  ,FRUITY  );
-		putmapchar(FRUITX+1,FRUITY  );
-		putmapchar(FRUITX-1,FRUITY+1);
-		putmapchar(FRUITX  ,FRUITY+1);
-		putmapchar(FRUITX+1,FRUITY+1);
+		fruiton=0;
+		dirtymapchar(FRUITX-1,FRUITY-1);
+		dirtymapchar(FRUITX  ,FRUITY-1);
+		dirtymapchar(FRUITX+1,FRUITY-1);
+		dirtymapchar(FRUITX-1,FRUITY  );
+		dirtymapchar(FRUITX  ,FRUITY  );
+		dirtymapchar(FRUITX+1,FRUITY  );
+		dirtymapchar(FRUITX-1,FRUITY+1);
+		dirtymapchar(FRUITX  ,FRUITY+1);
+		dirtymapchar(FRUITX+1,FRUITY+1);
+		if(!headless) tilemap_flush(&maplayer); //1行ずつまとめて表示
 	}
 }
 void getfruit(){
@@ -311,8 +279,10 @@ void getfruit(){
 	score+=fruitscore[fruitno];
 	fruitcount=0;
 	setfruit(0);
+	sound_update_begin(); //効果音の処理でも書き換えるため
 	fruitsound=22000;
 	fruitsoundcount=20;
+	sound_update_end();
 	fruitscoretimer=TIMER_FRUITSCORE;
 }
 
@@ -324,7 +294,8 @@ void displayscore(){
 void displayplayers(){
 	//プレイヤー残数表示
 	unsigned char i;
-	for(i=0;i<player && i<5;i++) putbmpmn(22*8+i*16,23*8,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[11]);
+	if(headless) return;
+	for(i=0;i<player && i<5;i++) putsprite(22*8+i*16,23*8,&Pacmanspr[11]);
 	for(;i<4;i++) clrbmpmn(22*8+i*16,23*8,XWIDTH_PACMAN,YWIDTH_PACMAN);
 }
 void displayfruits(){
@@ -333,42 +304,87 @@ void displayfruits(){
 	for(i=0;i<8 && i<stage;i++){
 		no=getfruitno(stage-i);
 		clrbmpmn (22*8+(i%4)*16,15*8+(i/4)*16,12,14);
-		putbmpmn(22*8+(i%4)*16,15*8+(i/4)*16,12,14,Fruitbmp[no]);
+		putsprite(22*8+(i%4)*16,15*8+(i/4)*16,&Fruitspr[no]);
+	}
+}
+static void makemazetable(void){
+	//面の開始時に、モンスターの進める方向と目玉が戻る方向の表を作る
+	//壁とドアは面の途中で変わらないので、移動中は表を引くだけでよい
+	static unsigned short queue[MAPXSIZE*MAPYSIZE];
+	unsigned short head,tail,i,n;
+	unsigned char x,y,d;
+	uint32_t up,down,down2,right,left,oneway;
+
+	for(y=0;y<MAPYSIZE;y++){
+		//1行分のマスについて、各方向に進めるかをビットごとにまとめて求める
+		//画面端は反対側へ抜けられるので進めるとする
+		up=(y==0) ? ~0u : ~wallbits[y-1];
+		down=(y==MAPYSIZE-1) ? ~0u : ~wallbits[y+1]; //目玉
+		down2=(y==MAPYSIZE-1) ? ~0u : ~(wallbits[y+1]|doorbits[y+1]); //目玉以外はドアも壁とみなす
+		right=~(wallbits[y]>>1);
+		left=~(wallbits[y]<<1);
+		oneway=0; //目玉以外は一方通行のマスから上に進めない
+		if(y==ONEWAY1Y+1) oneway|=BIT(ONEWAY1X);
+		if(y==ONEWAY2Y+1) oneway|=BIT(ONEWAY2X);
+		if(y==ONEWAY3Y+1) oneway|=BIT(ONEWAY3X);
+		if(y==ONEWAY4Y+1) oneway|=BIT(ONEWAY4X);
+		for(x=0;x<MAPXSIZE;x++){
+			i=y*MAPXSIZE+x;
+			d=((right>>x)&1)<<DIR_RIGHT | ((left>>x)&1)<<DIR_LEFT;
+			mazeexit[0][i]=d | ((up&~oneway)>>x&1)<<DIR_UP | ((down2>>x)&1)<<DIR_DOWN;
+			mazeexit[1][i]=d | ((up>>x)&1)<<DIR_UP | ((down>>x)&1)<<DIR_DOWN;
+			homedir[i]=0xff;
+		}
+	}
+	//モンスターハウスから幅優先探索し、各マスから1つ手前のマスへ進む方向を記録
+	//ワープゾーンのように画面端は反対側とつながる
+	head=tail=0;
+	queue[tail++]=MONSTERHOUSEY*MAPXSIZE+MONSTERHOUSEX;
+	while(head<tail){
+		i=queue[head++];
+		x=i%MAPXSIZE;
+		y=i/MAPXSIZE;
+		for(d=0;d<4;d++){
+			//マスnから方向dに進むとマスiに着く
+			if(d==DIR_UP) n=(y==MAPYSIZE-1 ? 0 : y+1)*MAPXSIZE+x;
+			else if(d==DIR_RIGHT) n=y*MAPXSIZE+(x==0 ? MAPXSIZE-1 : x-1);
+			else if(d==DIR_DOWN) n=(y==0 ? MAPYSIZE-1 : y-1)*MAPXSIZE+x;
+			else n=y*MAPXSIZE+(x==MAPXSIZE-1 ? 0 : x+1);
+			if(homedir[n]!=0xff || ISWALL(n%MAPXSIZE,n/MAPXSIZE) || n==queue[0]) continue;
+			if(!(mazeexit[1][n]&(1<<d))) continue;
+			homedir[n]=d;
+			queue[tail++]=n;
+		}
 	}
 }
 void putmap(void){
 	//通路、えさ、パワーえさの表示
-	unsigned char *p,*mapp;
+	unsigned char *p;
 	int i,j;
-	clearscreen();
+	if(!headless) clearscreen();
+	tilemap_fill(&maplayer,' ',0); //画面消去済み
 	p=scenedata;
-	mapp=map;
 	cookie=0;
+	fruiton=0;
 	for(i=0;i<MAPYSIZE;i++){
+		wallbits[i]=0;
+		cookiebits[i]=0;
+		powerbits[i]=0;
+		doorbits[i]=0;
 		for(j=0;j<MAPXSIZE;j++){
-			if(*p<=0x8d){
-				*mapp=MAP_WALL; //壁
-				printchar(j,i,COLOR_WALL,*p);
-			}
-			else if(*p==CODE_DOOR){
-				*mapp=MAP_DOOR; //ドア
-				printchar(j,i,COLOR_DOOR,CODE_DOOR);
-			}
-			else if(*p==CODE_COOKIE){
-				*mapp=MAP_COOKIE; //えさ
-				printchar(j,i,COLOR_COOKIE,CODE_COOKIE);
-				cookie++;
-			}
-			else if(*p==CODE_POWERCOOKIE){
-				*mapp=MAP_POWERCOOKIE; //パワーえさ
-				printchar(j,i,COLOR_POWERCOOKIE,CODE_POWERCOOKIE);
-				cookie++;
-			}
-			else *mapp=0;
+			if(*p<=0x8d) wallbits[i]|=BIT(j); //壁
+			else if(*p==CODE_DOOR) doorbits[i]|=BIT(j); //ドア
+			else if(*p==CODE_COOKIE) cookiebits[i]|=BIT(j); //えさ
+			else if(*p==CODE_POWERCOOKIE) powerbits[i]|=BIT(j); //パワーえさ
+			setmaptile(j,i);
 			p++;
-			mapp++;
 		}
+		cookie+=__builtin_popcount(cookiebits[i]|powerbits[i]); //えさの数
 	}
+	makemazetable(); //モンスターの進路表
+	if(headless) return;
+	tilemap_flush(&maplayer); //変化した文字を1行ずつまとめて表示
+	cookieblink=gamecount^0x10; //次のmovedisplaychars()でパワーえさを再表示
 	printstrc(21,1,7,"HI-SCORE");
 	printchar(27,3,7,'0');
 	printstrc(22,5,7,"1UP");
@@ -377,8 +393,8 @@ void putmap(void){
 	displayplayers();
 	displayfruits();
 }
-void initcharacter(_Character *p,unsigned char s,unsigned short x,unsigned short y,
-					unsigned char dir,unsigned short speed,unsigned char ac,unsigned short modec)
+void initcharacter(_Character *p,unsigned char s,UFIX8 x,UFIX8 y,
+					unsigned char dir,UFIX8 speed,unsigned char ac,unsigned short modec)
 {
 	//キャラクター初期化
 	//p:キャラクターのポインタ、s:モード（status）、（x,y):初期位置、dir:初期方向
@@ -450,32 +466,31 @@ void gameinit4(void)
 	fruitscoretimer=0;
 	huntedmonster=0;
 	monsterhuntedtimer=0;
+	sound_update_begin(); //効果音の処理でも書き換えるため
 	monstersoundcount=0;
 	cookiesoundcount=0;
 	fruitsoundcount=0;
 	over10000soundcount=0;
+	sound_update_end();
 	setfruit(0);//フルーツ削除、表示消去
-	initcharacter(&pacman,0,10*8*256,20*8*256,DIR_LEFT,pacmanspeed,5,0);
-	initcharacter(&akabei,NAWABARI,MONSTERHOUSEX*8*256,(MONSTERHOUSEY-2)*8*256,DIR_LEFT,monsterspeed,0,550);
-	initcharacter(&pinky ,NAWABARI,MONSTERHOUSEX*8*256,(MONSTERHOUSEY+1)*8*256,DIR_UP,monsterspeed,0,0);
-	initcharacter(&aosuke,TAIKI2,(MONSTERHOUSEX-1)*8*256,(MONSTERHOUSEY+1)*8*256,DIR_DOWN,monsterspeed,0,375);
-	initcharacter(&guzuta,TAIKI2,(MONSTERHOUSEX+1)*8*256,(MONSTERHOUSEY+1)*8*256,DIR_DOWN,monsterspeed,0,600);
+	initcharacter(&pacman,0,FIX(10*8),FIX(20*8),DIR_LEFT,pacmanspeed,5,0);
+	initcharacter(&akabei,NAWABARI,FIX(MONSTERHOUSEX*8),FIX((MONSTERHOUSEY-2)*8),DIR_LEFT,monsterspeed,0,550);
+	initcharacter(&pinky ,NAWABARI,FIX(MONSTERHOUSEX*8),FIX((MONSTERHOUSEY+1)*8),DIR_UP,monsterspeed,0,0);
+	initcharacter(&aosuke,TAIKI2,FIX((MONSTERHOUSEX-1)*8),FIX((MONSTERHOUSEY+1)*8),DIR_DOWN,monsterspeed,0,375);
+	initcharacter(&guzuta,TAIKI2,FIX((MONSTERHOUSEX+1)*8),FIX((MONSTERHOUSEY+1)*8),DIR_DOWN,monsterspeed,0,600);
 }
 
-void pac_keycheck()
+void pac_keycheck(uint32_t k)
 {
-	// ボタンチェックし、壁でなければパックマンの向き変更
-        uint32_t k;
-	unsigned char d;
+	// ボタンkをチェックし、壁でなければパックマンの向き変更
 	unsigned short x,y;
 
-	x=pacman.x/256;
-	y=pacman.y/256;
-        k = get_pad_vmask();
+	x=FIX_INT(pacman.x);
+	y=FIX_INT(pacman.y);
 	if((k & KEYUP) && (x%8)==0){	//上ボタン
 		if(pacman.dir!=DIR_UP){
 			if(y>=8){
-				if(GETMAP(x/8,y/8-1)!=MAP_WALL) pacman.dir=DIR_UP;
+				if(!ISWALL(x/8,y/8-1)) pacman.dir=DIR_UP;
 			}
 			else pacman.dir=DIR_UP;
 		}
@@ -483,7 +498,7 @@ void pac_keycheck()
 	else if((k & KEYRIGHT) && (y%8)==0){	//右ボタン
 		if(pacman.dir!=DIR_RIGHT){
 			if(x<=(MAPXSIZE-2)*8){
-				if(GETMAP(x/8+1,y/8)!=MAP_WALL) pacman.dir=DIR_RIGHT;
+				if(!ISWALL(x/8+1,y/8)) pacman.dir=DIR_RIGHT;
 			}
 			else pacman.dir=DIR_RIGHT;
 		}
@@ -491,8 +506,7 @@ void pac_keycheck()
 	else if((k&KEYDOWN) && (x%8)==0){	//下ボタン
 		if(pacman.dir!=DIR_DOWN){
 			if(y<=(MAPYSIZE-2)*8){
-				d=GETMAP(x/8,y/8+1);
-				if(d!=MAP_WALL && d!=MAP_DOOR) pacman.dir=DIR_DOWN;
+				if(!ISBLOCK(x/8,y/8+1)) pacman.dir=DIR_DOWN;
 			}
 			else pacman.dir=DIR_DOWN;
 		}
@@ -500,7 +514,7 @@ void pac_keycheck()
 	else if((k&KEYLEFT) && (y%8)==0){	//左ボタン
 		if(pacman.dir!=DIR_LEFT){
 			if(x>=8){
-				if(GETMAP(x/8-1,y/8)!=MAP_WALL) pacman.dir=DIR_LEFT;
+				if(!ISWALL(x/8-1,y/8)) pacman.dir=DIR_LEFT;
 			}
 			else pacman.dir=DIR_LEFT;
 		}
@@ -509,49 +523,48 @@ void pac_keycheck()
 
 void movepacman(){
 	//パックマン移動チェック
-	unsigned char t;
 	unsigned short x,y;
 
 	if(monsterhuntedtimer>0) return; //モンスター捕獲中は停止
-	x=pacman.x/256;
-	y=pacman.y/256;
+	x=FIX_INT(pacman.x);
+	y=FIX_INT(pacman.y);
 	switch(pacman.dir){
 		case DIR_UP: //上
 			if(y!=0){
-				if((y%8)!=0 || GETMAP(x/8,y/8-1)!=MAP_WALL) pacman.y-=pacman.speed;
+				if((y%8)!=0 || !ISWALL(x/8,y/8-1)) pacman.y-=pacman.speed;
 			}
-			else pacman.y=(MAPYSIZE-1)*8*256;
+			else pacman.y=FIX((MAPYSIZE-1)*8);
 			break;
 		case DIR_RIGHT: //右
 			if(x!=(MAPXSIZE-1)*8){
-				if((x%8)!=0 || GETMAP(x/8+1,y/8)!=MAP_WALL) pacman.x+=pacman.speed;
+				if((x%8)!=0 || !ISWALL(x/8+1,y/8)) pacman.x+=pacman.speed;
 			}
 			else pacman.x=0;
 			break;
 		case DIR_DOWN: //下。モンスターハウスのドアも壁とみなす
 			if(y!=(MAPYSIZE-1)*8){
-				t=GETMAP(x/8,y/8+1);
-				if((y%8)!=0 || t!=MAP_WALL && t!=MAP_DOOR) pacman.y+=pacman.speed;
+				if((y%8)!=0 || !ISBLOCK(x/8,y/8+1)) pacman.y+=pacman.speed;
 			}
 			else pacman.y=0;
 			break;
 		case DIR_LEFT: //左
 			if(x!=0){
-				if((x%8)!=0 || GETMAP(x/8-1,y/8)!=MAP_WALL) pacman.x-=pacman.speed;
+				if((x%8)!=0 || !ISWALL(x/8-1,y/8)) pacman.x-=pacman.speed;
 			}
-			else pacman.x=(MAPXSIZE-1)*8*256;
+			else pacman.x=FIX((MAPXSIZE-1)*8);
 	}
 }
-void movemonster(_Character *p,unsigned short tx,unsigned short ty){
+void movemonster(_Character *p,UFIX8 tx,UFIX8 ty){
 	//モンスターの移動方向決定し、移動させる
 	//p:モンスターのポインタ、tx:目標x座標、ty:目標y座標
 	unsigned char cUP,cRIGHT,cDOWN,cLEFT;
-	unsigned char t;
+	unsigned char e;
 	unsigned char olddir;
-	unsigned short x,y,x1,y1,oldx,oldy;
+	unsigned short x,y,x1,y1;
+	UFIX8 oldx,oldy;
 
-	x=p->x/256;
-	y=p->y/256;
+	x=FIX_INT(p->x);
+	y=FIX_INT(p->y);
 	x1=x/8;
 	y1=y/8;
 	oldx=p->oldx;
@@ -564,80 +577,59 @@ void movemonster(_Character *p,unsigned short tx,unsigned short ty){
 	//方向変更後、小数点以上移動するまで直進
 	//また、直進中も小数点以下移動の場合は直進する
 		case DIR_UP: //上
-			if(p->turn && y==oldy/256){
+			if(p->turn && y==FIX_INT(oldy)){
 				p->y-=p->speed;
 				return;
 			}
 			p->turn=0;
-			if(y==(unsigned short)((p->y-p->speed))/256){
+			if(y==FIX_INT((UFIX8)(p->y-p->speed))){
 				p->y-=p->speed;
 				return;
 			}
 			break;
 		case DIR_RIGHT: //右
-			if(p->turn && x==oldx/256){
+			if(p->turn && x==FIX_INT(oldx)){
 				p->x+=p->speed;
 				return;
 			}
 			p->turn=0;
-			if(x==(p->x+p->speed)/256){
+			if(x==FIX_INT(p->x+p->speed)){
 				p->x+=p->speed;
 				return;
 			}
 			break;
 		case DIR_DOWN: //下
-			if(p->turn && y==oldy/256){
+			if(p->turn && y==FIX_INT(oldy)){
 				p->y+=p->speed;
 				return;
 			}
 			p->turn=0;
-			if(y==(p->y+p->speed)/256){
+			if(y==FIX_INT(p->y+p->speed)){
 				p->y+=p->speed;
 				return;
 			}
 			break;
 		case DIR_LEFT: //左
-			if(p->turn && x==oldx/256){
+			if(p->turn && x==FIX_INT(oldx)){
 				p->x-=p->speed;
 				return;
 			}
 			p->turn=0;
-			if(x==(unsigned short)((p->x-p->speed))/256){
+			if(x==FIX_INT((UFIX8)(p->x-p->speed))){
 				p->x-=p->speed;
 				return;
 			}
 	}
 
 	//cUP、cRIGHT、cDOWN、cLEFT:それぞれの方向に通れる場合1、通れない場合0とする
-	cUP=1;
-	cRIGHT=1;
-	cDOWN=1;
-	cLEFT=1;
-	if((x%8)!=0){
-		cUP=0;
-		cDOWN=0;
-	}
-	else if((y%8)==0){
-		if(y1!=0 && GETMAP(x1,y1-1)==MAP_WALL) cUP=0;
-		//目玉のとき以外は一方通行チェック
-		else if(p->status!=MEDAMA &&
-		  (x1==ONEWAY1X && y1==ONEWAY1Y+1 || x1==ONEWAY2X && y1==ONEWAY2Y+1 ||
-		   x1==ONEWAY3X && y1==ONEWAY3Y+1 || x1==ONEWAY4X && y1==ONEWAY4Y+1)) cUP=0;
-		if(y1!=MAPYSIZE-1){
-			//目玉のとき以外はドアも壁とみなす
-			t=GETMAP(x1,y1+1);
-			if(t==MAP_WALL || (t==MAP_DOOR && p->status!=MEDAMA)) cDOWN=0;
-		}
-	}
-
-	if((y%8)!=0){
-		cRIGHT=0;
-		cLEFT=0;
-	}
-	else if((x%8)==0){
-		if(x1!=MAPXSIZE-1 && GETMAP(x1+1,y1)==MAP_WALL) cRIGHT=0;
-		if(x1!=0 && GETMAP(x1-1,y1)==MAP_WALL) cLEFT=0;
-	}
+	if((x%8)==0 && (y%8)==0) e=mazeexit[p->status==MEDAMA][y1*MAPXSIZE+x1]; //マスの中心では表を引く
+	else if((x%8)==0) e=(1<<DIR_UP)|(1<<DIR_DOWN); //縦に移動中
+	else if((y%8)==0) e=(1<<DIR_RIGHT)|(1<<DIR_LEFT); //横に移動中
+	else e=0;
+	cUP=(e>>DIR_UP)&1;
+	cRIGHT=(e>>DIR_RIGHT)&1;
+	cDOWN=(e>>DIR_DOWN)&1;
+	cLEFT=(e>>DIR_LEFT)&1;
 
 	tx>>=8;
 	ty>>=8;
@@ -645,6 +637,10 @@ void movemonster(_Character *p,unsigned short tx,unsigned short ty){
 		if(y==MONSTERHOUSEY*8) p->dir=DIR_DOWN;
 		else if(y==(MONSTERHOUSEY+1)*8) p->dir=DIR_UP;
 	}
+	else if(p->status==MEDAMA && (x%8)==0 && (y%8)==0 && homedir[y1*MAPXSIZE+x1]!=0xff){
+		//目玉はマスの中心で最短経路の方向を表から選ぶ
+		p->dir=homedir[y1*MAPXSIZE+x1];
+	}
 	else switch(p->dir){
 		case DIR_UP: //進行方向=上・・・優先順位　右→上→左
 			if(x<tx && cRIGHT) p->dir=DIR_RIGHT;
@@ -682,7 +678,7 @@ void movemonster(_Character *p,unsigned short tx,unsigned short ty){
 	switch(p->dir){
 		case DIR_UP: //上
 			if(y!=0) p->y-=p->speed;
-			else p->y=(MAPYSIZE-1)*8*256;
+			else p->y=FIX((MAPYSIZE-1)*8);
 			break;
 		case DIR_RIGHT: //右
 			if(x!=(MAPXSIZE-1)*8){
@@ -702,13 +698,13 @@ void movemonster(_Character *p,unsigned short tx,unsigned short ty){
 				if(y1==WARPY && (x1<WARPX1 || x1>=WARPX2) && p->status!=MEDAMA) p->x-=p->speed/2;
 				else p->x-=p->speed;
 			}
-			else p->x=(MAPXSIZE-1)*8*256;
+			else p->x=FIX((MAPXSIZE-1)*8);
 	}
 }
 
 void moveakabei(){
 	//アカベイ移動
-	unsigned short targetx,targety;
+	UFIX8 targetx,targety;
 
 	if(monsterhuntedtimer>0 && akabei.status!=MEDAMA) return; //誰かが捕獲されているとき目玉以外は停止
 	switch (akabei.status){
@@ -770,7 +766,7 @@ void moveakabei(){
 			}
 			break;
 		case MEDAMA:
-			if((akabei.x/256)==(MONSTERHOUSEX*8) && (akabei.y/256)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
+			if(FIX_INT(akabei.x)==(MONSTERHOUSEX*8) && FIX_INT(akabei.y)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
 				akabei.status=TAIKI2;
 				akabei.modecount=1;
 				akabei.dir=DIR_UP;
@@ -778,7 +774,7 @@ void moveakabei(){
 			}
 			break;
 		case TAIKI:
-			if((akabei.x/256)==(MONSTERHOUSEX*8) && (akabei.y/256)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
+			if(FIX_INT(akabei.x)==(MONSTERHOUSEX*8) && FIX_INT(akabei.y)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
 				akabei.status=OIKAKE;
 				akabei.modecount=TIMER_OIKAKE;
 				akabei.dir=DIR_LEFT;
@@ -793,27 +789,27 @@ void moveakabei(){
 	switch (akabei.status){
 		case NAWABARI:
 		case IJIKE:
-			targetx=NAWABARIAKABEIX*8*256;
-			targety=NAWABARIAKABEIY*8*256;
+			targetx=FIX(NAWABARIAKABEIX*8);
+			targety=FIX(NAWABARIAKABEIY*8);
 			break;
 		case OIKAKE:
 			targetx=pacman.x;
 			targety=pacman.y;
 			break;
 		case MEDAMA:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=MONSTERHOUSEY*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX(MONSTERHOUSEY*8);
 			break;
 		case TAIKI:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=(MONSTERHOUSEY-2)*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX((MONSTERHOUSEY-2)*8);
 	}
 	movemonster(&akabei,targetx,targety);
 }
 
 void movepinky(){
 	//ピンキー移動
-	unsigned short targetx,targety;
+	UFIX8 targetx,targety;
 
 	if(monsterhuntedtimer>0 && pinky.status!=MEDAMA) return; //誰かが捕獲されているとき目玉以外は停止
 	switch (pinky.status){
@@ -828,7 +824,7 @@ void movepinky(){
 			}
 			break;
 		case MEDAMA:
-			if((pinky.x/256)==(MONSTERHOUSEX*8) && (pinky.y/256)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
+			if(FIX_INT(pinky.x)==(MONSTERHOUSEX*8) && FIX_INT(pinky.y)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
 				pinky.status=TAIKI2;
 				pinky.modecount=1;
 				pinky.dir=DIR_UP;
@@ -837,7 +833,7 @@ void movepinky(){
 			else pinky.speed=medamaspeed;
 			break;
 		case TAIKI:
-			if((pinky.x/256)==(MONSTERHOUSEX*8) && (pinky.y/256)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
+			if(FIX_INT(pinky.x)==(MONSTERHOUSEX*8) && FIX_INT(pinky.y)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
 				pinky.status=OIKAKE;
 				pinky.dir=DIR_LEFT;
 			}
@@ -850,46 +846,46 @@ void movepinky(){
 	}
 	switch (pinky.status){
 		case NAWABARI:
-			targetx=NAWABARIPINKYX*8*256;
-			targety=NAWABARIPINKYY*8*256;
+			targetx=FIX(NAWABARIPINKYX*8);
+			targety=FIX(NAWABARIPINKYY*8);
 			break;
 		case IJIKE:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=MONSTERHOUSEY*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX(MONSTERHOUSEY*8);
 			break;
 		case OIKAKE: //パックマンの進行方向+3をターゲット座標とする
 			if(pacman.dir==DIR_UP){
 				targetx=pacman.x;
-				if(pacman.y>=4*8*256) targety=pacman.y-3*8*256;
-				else if(pacman.y/256/8==0) targety=(MAPYSIZE-3)*8*256;
-				else targety=1*8*256;
+				if(pacman.y>=FIX(4*8)) targety=pacman.y-FIX(3*8);
+				else if(FIX_INT(pacman.y)/8==0) targety=FIX((MAPYSIZE-3)*8);
+				else targety=FIX(1*8);
 			}
 			else if(pacman.dir==DIR_RIGHT){
 				targety=pacman.y;
-				if(pacman.x<=(MAPXSIZE-5)*8*256) targetx=pacman.x+3*8*256;
-				else if(pacman.x/256/8==(MAPXSIZE-1)*8) targetx=2*8*256;
-				else targetx=(MAPXSIZE-2)*8*256;
+				if(pacman.x<=FIX((MAPXSIZE-5)*8)) targetx=pacman.x+FIX(3*8);
+				else if(FIX_INT(pacman.x)/8==(MAPXSIZE-1)*8) targetx=FIX(2*8);
+				else targetx=FIX((MAPXSIZE-2)*8);
 			}
 			else if(pacman.dir==DIR_DOWN){
 				targetx=pacman.x;
-				if(pacman.y<=(MAPYSIZE-5)*8*256) targety=pacman.y+3*8*256;
-				else if(pacman.y/256/8==(MAPYSIZE-1)*8) targety=2*8*256;
-				else targety=(MAPYSIZE-2)*8*256;
+				if(pacman.y<=FIX((MAPYSIZE-5)*8)) targety=pacman.y+FIX(3*8);
+				else if(FIX_INT(pacman.y)/8==(MAPYSIZE-1)*8) targety=FIX(2*8);
+				else targety=FIX((MAPYSIZE-2)*8);
 			}
 			else if(pacman.dir==DIR_LEFT){
 				targety=pacman.y;
-				if(pacman.x>=4*8*256) targetx=pacman.x-3*8*256;
-				else if(pacman.x/256/8==0) targetx=(MAPXSIZE-3)*8*256;
-				else targetx=1*8*256;
+				if(pacman.x>=FIX(4*8)) targetx=pacman.x-FIX(3*8);
+				else if(FIX_INT(pacman.x)/8==0) targetx=FIX((MAPXSIZE-3)*8);
+				else targetx=FIX(1*8);
 			}
 			break;
 		case MEDAMA:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=MONSTERHOUSEY*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX(MONSTERHOUSEY*8);
 			break;
 		case TAIKI:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=(MONSTERHOUSEY-2)*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX((MONSTERHOUSEY-2)*8);
 	}
 	movemonster(&pinky,targetx,targety);
 }
@@ -897,7 +893,7 @@ void movepinky(){
 void moveaosuke()
 {
 	//アオスケ移動
-	unsigned short targetx,targety;
+	UFIX8 targetx,targety;
 
 	if(monsterhuntedtimer>0 && aosuke.status!=MEDAMA) return; //誰かが捕獲されているとき目玉以外は停止
 	switch (aosuke.status){
@@ -912,7 +908,7 @@ void moveaosuke()
 			}
 			break;
 		case MEDAMA:
-			if((aosuke.x/256)==(MONSTERHOUSEX*8) && (aosuke.y/256)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
+			if(FIX_INT(aosuke.x)==(MONSTERHOUSEX*8) && FIX_INT(aosuke.y)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
 				aosuke.status=TAIKI2;
 				aosuke.modecount=1;
 				aosuke.dir=DIR_UP;
@@ -920,7 +916,7 @@ void moveaosuke()
 			}
 			break;
 		case TAIKI:
-			if((aosuke.x/256)==(MONSTERHOUSEX*8) && (aosuke.y/256)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
+			if(FIX_INT(aosuke.x)==(MONSTERHOUSEX*8) && FIX_INT(aosuke.y)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
 				aosuke.status=OIKAKE;
 				aosuke.dir=DIR_LEFT;
 			}
@@ -933,30 +929,25 @@ void moveaosuke()
 	}
 	switch (aosuke.status){
 		case NAWABARI:
-			targetx=NAWABARIAOSUKEX*8*256;
-			targety=NAWABARIAOSUKEY*8*256;
+			targetx=FIX(NAWABARIAOSUKEX*8);
+			targety=FIX(NAWABARIAOSUKEY*8);
 			break;
 		case IJIKE:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=MONSTERHOUSEY*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX(MONSTERHOUSEY*8);
 			break;
 		case OIKAKE: //パックマン中心にアカベイと点対称の位置をターゲット座標とする
-			targetx=pacman.x/2-akabei.x/4;
-			targety=pacman.y/2-akabei.y/4;
-			if(targetx>=32768) targetx=0;
-			else if(targetx>=16384) targetx=16383;
-			if(targety>=32768) targety=0;
-			else if(targety>=16384) targety=16383;
-			targetx<<=2;
-			targety<<=2;
+			//アカベイからパックマンへの距離を2倍に延ばした点。16ビットに収まるよう1/4で計算し、画面外は端に寄せる
+			targetx=fix_clamp(pacman.x/2-akabei.x/4,0,FIX(64)-1)*4;
+			targety=fix_clamp(pacman.y/2-akabei.y/4,0,FIX(64)-1)*4;
 			break;
 		case MEDAMA:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=MONSTERHOUSEY*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX(MONSTERHOUSEY*8);
 			break;
 		case TAIKI:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=(MONSTERHOUSEY-2)*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX((MONSTERHOUSEY-2)*8);
 	}
 	movemonster(&aosuke,targetx,targety);
 }
@@ -964,7 +955,7 @@ void moveaosuke()
 void moveguzuta()
 {
 	//グズタ移動
-	unsigned short targetx,targety;
+	UFIX8 targetx,targety;
 	short dx,dy;
 
 	if(monsterhuntedtimer>0 && guzuta.status!=MEDAMA) return; //誰かが捕獲されているとき目玉以外は停止
@@ -980,7 +971,7 @@ void moveguzuta()
 			}
 			break;
 		case MEDAMA:
-			if((guzuta.x/256)==(MONSTERHOUSEX*8) && (guzuta.y/256)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
+			if(FIX_INT(guzuta.x)==(MONSTERHOUSEX*8) && FIX_INT(guzuta.y)==(MONSTERHOUSEY*8)){ //モンスターハウス到着
 				guzuta.status=TAIKI2;
 				guzuta.modecount=1;
 				guzuta.dir=DIR_UP;
@@ -988,7 +979,7 @@ void moveguzuta()
 			}
 			break;
 		case TAIKI:
-			if((guzuta.x/256)==(MONSTERHOUSEX*8) && (guzuta.y/256)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
+			if(FIX_INT(guzuta.x)==(MONSTERHOUSEX*8) && FIX_INT(guzuta.y)==((MONSTERHOUSEY-2)*8)){ //モンスターハウスから出た
 				guzuta.status=OIKAKE;
 				guzuta.dir=DIR_LEFT;
 			}
@@ -1001,40 +992,39 @@ void moveguzuta()
 	}
 	switch (guzuta.status){
 		case NAWABARI:
-			targetx=NAWABARIGUZUTAX*8*256;
-			targety=NAWABARIGUZUTAY*8*256;
+			targetx=FIX(NAWABARIGUZUTAX*8);
+			targety=FIX(NAWABARIGUZUTAY*8);
 			break;
 		case IJIKE:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=MONSTERHOUSEY*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX(MONSTERHOUSEY*8);
 			break;
 		case OIKAKE: //パックマンから遠くにいるときは近づいてくるが、近づくと別を目指す
-			dx=(short)(guzuta.x/256/8)-(short)(pacman.x/256/8);
-			dy=(short)(guzuta.y/256/8)-(short)(pacman.y/256/8);
+			dx=(short)(FIX_INT(guzuta.x)/8)-(short)(FIX_INT(pacman.x)/8);
+			dy=(short)(FIX_INT(guzuta.y)/8)-(short)(FIX_INT(pacman.y)/8);
 			if(dx*dx+dy*dy>10){
 				targetx=pacman.x;
 				targety=pacman.y;
 			}
 			else{
-				targetx=NAWABARIGUZUTAX*8*256;
-				targety=NAWABARIGUZUTAY*8*256;
+				targetx=FIX(NAWABARIGUZUTAX*8);
+				targety=FIX(NAWABARIGUZUTAY*8);
 			}
 			break;
 		case MEDAMA:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=MONSTERHOUSEY*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX(MONSTERHOUSEY*8);
 			break;
 		case TAIKI:
-			targetx=MONSTERHOUSEX*8*256;
-			targety=(MONSTERHOUSEY-2)*8*256;
+			targetx=FIX(MONSTERHOUSEX*8);
+			targety=FIX((MONSTERHOUSEY-2)*8);
 	}
 	movemonster(&guzuta,targetx,targety);
 }
 
-static void sound(void){
-	//効果音出力
-	//60分の1秒ごとに呼び出し
-	//後ろのほうで処理するものほど優先的に鳴らす
+static int sound(void){
+	//モンスターの効果音出力
+	//サウンドエンジンから60分の1秒ごとに呼び出し
 	unsigned short pr;//タイマーカウンター値
 	unsigned short monsterspeed2;
 	pr=0;
@@ -1075,6 +1065,15 @@ static void sound(void){
 		monstersoundcount++;
 		if(monstersoundcount>monsterspeed2*2) monstersoundcount=0;
 	}
+	return pr/14; //実際に周期変更
+}
+
+static int eventsound(void){
+	//えさ、フルーツ等の効果音出力、鳴らしている間はモンスターの音より優先
+	//サウンドエンジンから60分の1秒ごとに呼び出し
+	//後ろのほうで処理するものほど優先的に鳴らす
+	unsigned short pr;//タイマーカウンター値
+	pr=0;
 
 //えさを食べる音
 	if(cookiesoundcount!=0){
@@ -1107,7 +1106,8 @@ static void sound(void){
 		over10000soundcount--;
 	}
 
-	sound_on(pr/14); //実際に周期変更
+	if(pr==0) return SOUND_SKIP; //モンスターの音を鳴らす
+	return pr/14; //実際に周期変更
 }
 
 void erasechars2(_Character *p){
@@ -1115,8 +1115,8 @@ void erasechars2(_Character *p){
 	unsigned short x,y;
 	unsigned char x2,y2;
 
-	x=p->x/256;
-	y=p->y/256;
+	x=FIX_INT(p->x);
+	y=FIX_INT(p->y);
 	x2=(unsigned char)(x/8);
 	y2=(unsigned char)(y/8);
 	if((y%8)<3 && y2>0){
@@ -1158,24 +1158,95 @@ void putpowercookies(){
 	putmapchar(POWERCOOKIEX3,POWERCOOKIEY3);
 	putmapchar(POWERCOOKIEX4,POWERCOOKIEY4);
 }
-void displaychars(){
+static void drawchars(){
 	// フルーツ、イジケ、パックマン、イジケ以外のモンスターの順に表示
-	blinkpowercookie(); //パワーえさの点滅
-	putpowercookies();
 	if(fruitcount>0) putfruit();
-	else if(fruitscoretimer>0) putbmpmn3(FRUITX*8-4,FRUITY*8,XWIDTH_SCORE,YWIDTH_SCORE,Scorebmp[4+fruitno]);
+	else if(fruitscoretimer>0) putspriteclip(FRUITX*8-4,FRUITY*8,&Scorespr[4+fruitno],MAPXSIZE*8,MAPYSIZE*8);
 	if(akabei.status==IJIKE) putmonster(&akabei);
 	if(aosuke.status==IJIKE) putmonster(&aosuke);
 	if(guzuta.status==IJIKE) putmonster(&guzuta);
 	if(pinky.status==IJIKE) putmonster(&pinky);
 	if(monsterhuntedtimer!=0)//イジケを食べたときの得点表示
-		putbmpmn3((int)(pacman.x/256)-4,(int)(pacman.y/256),XWIDTH_SCORE,YWIDTH_SCORE,Scorebmp[huntedmonster-1]);
-	else putpacman();
+		putspriteclip((int)FIX_INT(pacman.x)-4,(int)FIX_INT(pacman.y),&Scorespr[huntedmonster-1],MAPXSIZE*8,MAPYSIZE*8);
+	else drawpacman();
 	if(akabei.status!=IJIKE) putmonster(&akabei);
 	if(aosuke.status!=IJIKE) putmonster(&aosuke);
 	if(guzuta.status!=IJIKE) putmonster(&guzuta);
 	if(pinky.status!=IJIKE) putmonster(&pinky);
 }
+void displaychars(){
+	// キャラクター表示
+	blinkpowercookie(); //パワーえさの点滅
+	putpowercookies();
+	if(monsterhuntedtimer==0) animpacman();
+	drawchars();
+}
+static void getarea(_Character *p,_Area *a){
+	// erasechars2()で書き直す、キャラクターを表示した場所の周囲の範囲を求める
+	unsigned short x,y;
+	unsigned char x2,y2;
+
+	x=FIX_INT(p->x);
+	y=FIX_INT(p->y);
+	x2=(unsigned char)(x/8);
+	y2=(unsigned char)(y/8);
+	a->x1=((x%8)<4 && x2>0) ? x2-1 : x2;
+	if((x%8)>=5 && x2<MAPXSIZE-2) a->x2=x2+2;
+	else if(x2<MAPXSIZE-1) a->x2=x2+1;
+	else a->x2=x2;
+	a->y1=((y%8)<3 && y2>0) ? y2-1 : y2;
+	if((y%8)>=6 && y2<MAPYSIZE-2) a->y2=y2+2;
+	else if(y2<MAPYSIZE-1) a->y2=y2+1;
+	else a->y2=y2;
+}
+void savechars(){
+	// 移動前の表示範囲を記録
+	unsigned char i;
+	for(i=0;i<5;i++) getarea(chars[i],&oldarea[i]);
+}
+static int redrawarea(const _Area *a){
+	// 範囲aのマップとキャラクターを合成し、1回の転送で描き直す
+	// 範囲が合成できる大きさを超える場合は何もせず0を返す
+	unsigned char x,y;
+	if(!compose_begin(a->x1*8,a->y1*8,a->x2*8+7,a->y2*8+7)) return 0;
+	for(y=a->y1;y<=a->y2;y++){
+		for(x=a->x1;x<=a->x2;x++) putmapchar(x,y);
+	}
+	drawchars(); //範囲外の部分は無視される
+	compose_end();
+	return 1;
+}
+void movedisplaychars(){
+	// erasechars()とdisplaychars()の代わりに、キャラクターごとに移動前の消去と
+	// 移動後の表示を合わせた範囲を合成して1回で転送する
+	_Area a,u;
+	unsigned char i;
+	blinkpowercookie(); //パワーえさの点滅
+	if((gamecount^cookieblink)&0x10){
+		//点滅が切り替わったときだけ再表示
+		cookieblink=gamecount;
+		dirtymapchar(POWERCOOKIEX1,POWERCOOKIEY1);
+		dirtymapchar(POWERCOOKIEX2,POWERCOOKIEY2);
+		dirtymapchar(POWERCOOKIEX3,POWERCOOKIEY3);
+		dirtymapchar(POWERCOOKIEX4,POWERCOOKIEY4);
+	}
+	tilemap_flush(&maplayer);
+	if(monsterhuntedtimer==0) animpacman();
+	if(fruitcount>0) putfruit();
+	else if(fruitscoretimer>0) putspriteclip(FRUITX*8-4,FRUITY*8,&Scorespr[4+fruitno],MAPXSIZE*8,MAPYSIZE*8);
+	for(i=0;i<5;i++){
+		getarea(chars[i],&a);
+		u.x1=a.x1<oldarea[i].x1 ? a.x1 : oldarea[i].x1;
+		u.y1=a.y1<oldarea[i].y1 ? a.y1 : oldarea[i].y1;
+		u.x2=a.x2>oldarea[i].x2 ? a.x2 : oldarea[i].x2;
+		u.y2=a.y2>oldarea[i].y2 ? a.y2 : oldarea[i].y2;
+		if(!redrawarea(&u)){
+			//トンネルを抜けた場合などは別々に描き直す
+			redrawarea(&oldarea[i]);
+			redrawarea(&a);
+		}
+	}
+}
 void fruitcheck(){
 	//フルーツ出現、消滅チェック、
 	if(fruitflag1 && cookie==FRUITTIME1){
@@ -1195,9 +1266,10 @@ void fruitcheck(){
 	else if(fruitscoretimer>0){ //フルーツを食べたときのスコア消去
 		fruitscoretimer--;
 		if(fruitscoretimer==0){
-			putmapchar(FRUITX-1,FRUITY);
-			putmapchar(FRUITX  ,FRUITY);
-			putmapchar(FRUITX+1,FRUITY);
+			dirtymapchar(FRUITX-1,FRUITY);
+			dirtymapchar(FRUITX  ,FRUITY);
+			dirtymapchar(FRUITX+1,FRUITY);
+			if(!headless) tilemap_flush(&maplayer);
 		}
 	}
 }
@@ -1233,8 +1305,8 @@ unsigned char monsterhuntcheck(_Character *p){
 	short dx,dy;
 
 	if(p->status==MEDAMA) return 0;
-	dx=(short)(p->x/256)-(short)(pacman.x/256);
-	dy=(short)(p->y/256)-(short)(pacman.y/256);
+	dx=(short)FIX_INT(p->x)-(short)FIX_INT(pacman.x);
+	dy=(short)FIX_INT(p->y)-(short)FIX_INT(pacman.y);
 	if(dx!=0 && dy!=0) return 0;
 	if(dx<=-(XWIDTH_MONSTER-HANTEI) || dx>=XWIDTH_PACMAN-HANTEI ||
 	   dy<=-(YWIDTH_MONSTER-HANTEI) || dy>=YWIDTH_PACMAN-HANTEI) return 0;
@@ -1245,8 +1317,10 @@ unsigned char monsterhuntcheck(_Character *p){
 		huntedmonster++;
 		p->speed=medamaspeed;
 		score+=(1<<huntedmonster)*10;
+		sound_update_begin();
 		monsterhuntedtimer=TIMER_HUNTEDSTOP;//停止時間
 		monsterhuntedsound=5100;
+		sound_update_end();
 		return 1;
 	}
 	gamestatus=2;
@@ -1258,8 +1332,8 @@ void huntedcheck(void){
 	unsigned char d,x,y;
 
 	if(monsterhuntedtimer>0) return; //目玉以外停止中
-	x=pacman.x/256;
-	y=pacman.y/256;
+	x=FIX_INT(pacman.x);
+	y=FIX_INT(pacman.y);
 	if((x%8)==4 || (y%8)==4){
 		x/=8;
 		y/=8;
@@ -1268,17 +1342,21 @@ void huntedcheck(void){
 		d=GETMAP(x,y);
 		if(d==MAP_COOKIE){
 			//えさ食べた
-			SETMAP(x,y,MAP_NONE);
+			cookiebits[y]&=~BIT(x);
 			score++;
 			cookie--;
+			sound_update_begin();
 			cookiesoundcount=4;
+			sound_update_end();
 		}
 		else if(d==MAP_POWERCOOKIE){
 			//パワーえさ食べた
-			SETMAP(x,y,MAP_NONE);
+			powerbits[y]&=~BIT(x);
 			score+=5;
 			cookie--;
+			sound_update_begin();
 			cookiesoundcount=4;
+			sound_update_end();
 			huntedmonster=0;
 			setmonsterijike(&akabei);
 			setmonsterijike(&pinky);
@@ -1303,7 +1381,9 @@ void huntedcheck(void){
 		upflag=1;
 		player++;
 		displayplayers();
+		sound_update_begin();
 		over10000soundcount=63;
+		sound_update_end();
 	}
 	if(akabei.status!=IJIKE && monsterhuntcheck(&akabei)) return;
 	if(pinky.status!=IJIKE && monsterhuntcheck(&pinky)) return;
@@ -1316,18 +1396,18 @@ void coffeebreak1(void){
 	unsigned char i;
 	unsigned char a1,ac1,av1;
 	unsigned char a2,ac2;
-	int pacx,akax,pacspeed,akaspeed;
+	FIX8 pacx,akax,pacspeed,akaspeed;
 	clearscreen();
-	pacx=255*256;
-	akax=300*256;
+	pacx=FIX(255);
+	akax=FIX(300);
 	ac1=5;
 	av1=0;
 	a2=0;
 	ac2=4;
-	pacspeed=-290*256/245;
-	akaspeed=-320*256/245;
+	pacspeed=FIX_RATIO(-290,245);
+	akaspeed=FIX_RATIO(-320,245);
 	startmusic(musicdata2);
-	while(akax>-20*256){
+	while(akax>-FIX(20)){
 		ac1--;
 		if(ac1==0){
 			ac1=5;
@@ -1342,28 +1422,28 @@ void coffeebreak1(void){
 			ac2=4;
 			a2^=1;
 		}
-		putbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[a1]);
-		putbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[6+a2]);
-		playmusic60thsec();
-		clrbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN);
-		clrbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER);
+		putsprite2(FIX_INT(pacx),100,&Pacmanspr[a1],0);
+		putsprite2(FIX_INT(akax),101,&Monsterspr[6+a2],0);
+		wait60thsec(1);
+		clrbmpmn(FIX_INT(pacx),100,XWIDTH_PACMAN,YWIDTH_PACMAN);
+		clrbmpmn(FIX_INT(akax),101,XWIDTH_MONSTER,YWIDTH_MONSTER);
 		pacx+=pacspeed;
 		akax+=akaspeed;
 	}
 
 	for(i=0;i<20;i++){
-		playmusic60thsec();
+		wait60thsec(1);
 	}
 
-	pacx=-75*256;
-	akax=-15*256;
+	pacx=-FIX(75);
+	akax=-FIX(15);
 	ac1=5;
 	av1=0;
 	a2=0;
 	ac2=4;
-	pacspeed=330*256/225;
-	akaspeed=300*256/225;
-	while(pacx<260*256){
+	pacspeed=FIX_RATIO(330,225);
+	akaspeed=FIX_RATIO(300,225);
+	while(pacx<FIX(260)){
 		ac1--;
 		if(ac1==0){
 			ac1=5;
@@ -1377,34 +1457,34 @@ void coffeebreak1(void){
 			ac2=4;
 			a2^=1;
 		}
-		putbmpmn(pacx/256,83,31,31,Bigpacbmp[a1]);
-		putbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER,Ijikebmp[a2]);
-		playmusic60thsec();
-		clrbmpmn(pacx/256,83,31,31);
-		clrbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER);
+		putsprite2(FIX_INT(pacx),83,&Bigpacspr[a1],0);
+		putsprite2(FIX_INT(akax),101,&Ijikespr[a2],0);
+		wait60thsec(1);
+		clrbmpmn(FIX_INT(pacx),83,31,31);
+		clrbmpmn(FIX_INT(akax),101,XWIDTH_MONSTER,YWIDTH_MONSTER);
 		pacx+=pacspeed;
 		akax+=akaspeed;
 	}
 	for(i=0;i<30;i++){
-		playmusic60thsec();
+		wait60thsec(1);
 	}
 }
 void coffeebreak2(void){
 	unsigned char i;
 	unsigned char a1,ac1,av1;
 	unsigned char a2,ac2;
-	int pacx,akax,pacspeed,akaspeed;
+	FIX8 pacx,akax,pacspeed,akaspeed;
 	clearscreen();
-	pacx=255*256;
-	akax=300*256;
+	pacx=FIX(255);
+	akax=FIX(300);
 	ac1=5;
 	av1=0;
 	a2=0;
 	ac2=4;
-	pacspeed=-290*256/245;
-	akaspeed=-320*256/245;
+	pacspeed=FIX_RATIO(-290,245);
+	akaspeed=FIX_RATIO(-320,245);
 	startmusic(musicdata2+82);
-	while(akax>110*256){
+	while(akax>FIX(110)){
 		ac1--;
 		if(ac1==0){
 			ac1=5;
@@ -1419,17 +1499,17 @@ void coffeebreak2(void){
 			ac2=4;
 			a2^=1;
 		}
-		putbmpmn(122,111,1,4,Pinbmp);
-		putbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[a1]);
-		putbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[6+a2]);
-		playmusic60thsec();
-		clrbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN);
-		clrbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER);
+		putsprite(122,111,&Pinspr[0]);
+		putsprite(FIX_INT(pacx),100,&Pacmanspr[a1]);
+		putsprite(FIX_INT(akax),101,&Monsterspr[6+a2]);
+		wait60thsec(1);
+		clrbmpmn(FIX_INT(pacx),100,XWIDTH_PACMAN,YWIDTH_PACMAN);
+		clrbmpmn(FIX_INT(akax),101,XWIDTH_MONSTER,YWIDTH_MONSTER);
 		pacx+=pacspeed;
 		akax+=akaspeed;
 	}
-	akaspeed=-9*256/80;
-	while(akax>100*256){
+	akaspeed=FIX_RATIO(-9,80);
+	while(akax>FIX(100)){
 		ac1--;
 		if(ac1==0){
 			ac1=5;
@@ -1444,40 +1524,40 @@ void coffeebreak2(void){
 			ac2=4;
 			a2^=1;
 		}
-		putbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[a1]);
-		putbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[6+a2]);
-		playmusic60thsec();
-		clrbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN);
-		clrbmpmn(akax/256,101,XWIDTH_MONSTER-1,YWIDTH_MONSTER);
-		clrbmpmn(akax/256+XWIDTH_MONSTER-1,101,1,YWIDTH_MONSTER-4);
+		putsprite(FIX_INT(pacx),100,&Pacmanspr[a1]);
+		putsprite(FIX_INT(akax),101,&Monsterspr[6+a2]);
+		wait60thsec(1);
+		clrbmpmn(FIX_INT(pacx),100,XWIDTH_PACMAN,YWIDTH_PACMAN);
+		clrbmpmn(FIX_INT(akax),101,XWIDTH_MONSTER-1,YWIDTH_MONSTER);
+		clrbmpmn(FIX_INT(akax)+XWIDTH_MONSTER-1,101,1,YWIDTH_MONSTER-4);
 		pacx+=pacspeed;
 		akax+=akaspeed;
 	}
-	putbmpmn(akax/256,101,22,13,Yabukebmp[0]);
+	putsprite(FIX_INT(akax),101,&Yabukespr[0]);
 	for(i=0;i<20;i++){
-		playmusic60thsec();
+		wait60thsec(1);
 	}
-	putbmpmn(akax/256,101,22,13,Yabukebmp[1]);
+	putsprite(FIX_INT(akax),101,&Yabukespr[1]);
 	for(i=0;i<60;i++){
-		playmusic60thsec();
+		wait60thsec(1);
 	}
 }
 void coffeebreak3(void){
 	unsigned char i;
 	unsigned char a1,ac1,av1;
 	unsigned char a2,ac2;
-	int pacx,akax,pacspeed,akaspeed;
+	FIX8 pacx,akax,pacspeed,akaspeed;
 	clearscreen();
-	pacx=255*256;
-	akax=300*256;
+	pacx=FIX(255);
+	akax=FIX(300);
 	ac1=5;
 	av1=0;
 	a2=0;
 	ac2=4;
-	pacspeed=-290*256/245;
-	akaspeed=-320*256/245;
+	pacspeed=FIX_RATIO(-290,245);
+	akaspeed=FIX_RATIO(-320,245);
 	startmusic(musicdata2);
-	while(akax>-20*256){
+	while(akax>-FIX(20)){
 		ac1--;
 		if(ac1==0){
 			ac1=5;
@@ -1492,36 +1572,36 @@ void coffeebreak3(void){
 			ac2=4;
 			a2^=1;
 		}
-		putbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[a1]);
-		putbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER,Yabuke2bmp[a2]);
-		playmusic60thsec();
-		clrbmpmn(pacx/256,100,XWIDTH_PACMAN,YWIDTH_PACMAN);
-		clrbmpmn(akax/256,101,XWIDTH_MONSTER,YWIDTH_MONSTER);
+		putsprite2(FIX_INT(pacx),100,&Pacmanspr[a1],0);
+		putsprite2(FIX_INT(akax),101,&Yabuke2spr[a2],0);
+		wait60thsec(1);
+		clrbmpmn(FIX_INT(pacx),100,XWIDTH_PACMAN,YWIDTH_PACMAN);
+		clrbmpmn(FIX_INT(akax),101,XWIDTH_MONSTER,YWIDTH_MONSTER);
 		pacx+=pacspeed;
 		akax+=akaspeed;
 	}
 
 	for(i=0;i<20;i++){
-		playmusic60thsec();
+		wait60thsec(1);
 	}
 
-	akax=-25*256;
+	akax=-FIX(25);
 	a2=0;
 	ac2=4;
-	akaspeed=280*256/225;
-	while(akax<260*256){
+	akaspeed=FIX_RATIO(280,225);
+	while(akax<FIX(260)){
 		ac2--;
 		if(ac2==0){
 			ac2=4;
 			a2^=1;
 		}
-		putbmpmn(akax/256,101,22,13,Hadakabmp[a2]);
-		playmusic60thsec();
-		clrbmpmn(akax/256,101,22,13);
+		putsprite2(FIX_INT(akax),101,&Hadakaspr[a2],0);
+		wait60thsec(1);
+		clrbmpmn(FIX_INT(akax),101,22,13);
 		akax+=akaspeed;
 	}
 	for(i=0;i<30;i++){
-		playmusic60thsec();
+		wait60thsec(1);
 	}
 }
 void gamestart(void){
@@ -1530,14 +1610,14 @@ void gamestart(void){
 	if(gamestatus==0){ //ゲーム開始時
 		startmusic(musicdata1);//ゲームスタートの音楽開始
 		for(i=0;i<120;i++){ //まず2秒間演奏
-			playmusic60thsec();
+			wait60thsec(1);
 		}
 		//キャラクター表示して最後まで演奏
 		player--;
 		displaychars();
 		displayplayers();
-		while(music.stop==0){
-			playmusic60thsec();
+		while(sound_playing(SOUND_MUSIC)){
+			wait60thsec(1);
 		}
 	}
 	else{
@@ -1560,7 +1640,7 @@ void deadanim(void){
 
 	for(i=0;i<9;i++){
 		erasechars2(&pacman);
-		putbmpmn3(pacman.x/256-3,pacman.y/256-3,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmandeadbmp[i]);
+		putspriteclip(FIX_INT(pacman.x)-3,FIX_INT(pacman.y)-3,&Pacmandeadspr[i],MAPXSIZE*8,MAPYSIZE*8);
 		if(i>1 && i<8){
 			for(j=0;j<13;j++){
 				sound_on((2400+(i-2)*320+(2400+(i-2)*320)*(12-j)/12)/14);
@@ -1644,7 +1724,7 @@ void title(void){
 	int i;
 	unsigned char a1,ac1,av1;
 	unsigned char a2,ac2;
-	int pacx,akax,pacspeed,akaspeed;
+	FIX8 pacx,akax,pacspeed,akaspeed;
 
 	while(1){
 		clearscreen();
@@ -1657,7 +1737,7 @@ void title(void){
 		printchar(25,3,7,'0');
 
 		//ロゴ表示
-		putbmpmn(63,80,114,36,Titlelogobmp[0]);
+		putsprite2(63,80,&Titlelogospr[0],0);
 
 		printstrc( 4,20,7,"FOR RASPBERRY PI PICO");
 		printstrc(10,22,7,"BY KENKEN");
@@ -1674,22 +1754,22 @@ void title(void){
 		printchar(25,3,7,'0');
 		printstrc(4,6,7,"CHARACTER  /  NICKNAME");
 		if(startkeycheck(50)) return;
-		putbmpmn(3*8-3,8*8-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[AKABEI*8+2]);
+		putsprite2(3*8-3,8*8-3,&Monsterspr[AKABEI*8+2],0);
 		printstrc(5,8,COLOR_AKABEI,"OIKAKE\x90\x90\x90\x90\x90\x90\x90");
 		if(startkeycheck(50)) return;
 		printstrc(18,8,COLOR_AKABEI,"\"AKABEI\"");
 		if(startkeycheck(50)) return;
-		putbmpmn(3*8-3,10*8-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[PINKY*8+2]);
+		putsprite2(3*8-3,10*8-3,&Monsterspr[PINKY*8+2],0);
 		printstrc(5,10,COLOR_PINKY,"MACHIBUSE\x90\x90\x90\x90");
 		if(startkeycheck(50)) return;
 		printstrc(18,10,COLOR_PINKY,"\"PINKY\"");
 		if(startkeycheck(50)) return;
-		putbmpmn(3*8-3,12*8-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[AOSUKE*8+2]);
+		putsprite2(3*8-3,12*8-3,&Monsterspr[AOSUKE*8+2],0);
 		printstrc(5,12,COLOR_AOSUKE,"KIMAGURE\x90\x90\x90\x90\x90");
 		if(startkeycheck(50)) return;
 		printstrc(18,12,COLOR_AOSUKE,"\"AOSUKE\"");
 		if(startkeycheck(50)) return;
-		putbmpmn(3*8-3,14*8-3,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[GUZUTA*8+2]);
+		putsprite2(3*8-3,14*8-3,&Monsterspr[GUZUTA*8+2],0);
 		printstrc(5,14,COLOR_GUZUTA,"OTOBOKE\x90\x90\x90\x90\x90\x90");
 		if(startkeycheck(50)) return;
 		printstrc(18,14,COLOR_GUZUTA,"\"GUZUTA\"");
@@ -1701,15 +1781,15 @@ void title(void){
 		printstrc(6,25,4,"PUSH START BUTTON");
 
 		gamecount=0;
-		pacx=239*256;
-		akax=264*256;
+		pacx=FIX(239);
+		akax=FIX(264);
 		ac1=5;
 		av1=0;
 		a2=0;
 		ac2=4;
 		pacspeed=-200;
 		akaspeed=-200;
-		while(pacx>46*256){
+		while(pacx>FIX(46)){
 			ac1--;
 			if(ac1==0){
 				ac1=5;
@@ -1725,14 +1805,14 @@ void title(void){
 				a2^=1;
 			}
 			printchar(6,17,COLOR_POWERCOOKIE,CODE_POWERCOOKIE);
-			putbmpmn(pacx/256,133,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[a1]);
-			putbmpmn(akax/256,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[AKABEI*8+6+a2]);
-			putbmpmn(akax/256+18,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[PINKY*8+6+a2]);
-			putbmpmn(akax/256+36,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[AOSUKE*8+6+a2]);
-			putbmpmn(akax/256+54,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Monsterbmp[GUZUTA*8+6+a2]);
+			putsprite(FIX_INT(pacx),133,&Pacmanspr[a1]);
+			putsprite(FIX_INT(akax),134,&Monsterspr[AKABEI*8+6+a2]);
+			putsprite(FIX_INT(akax)+18,134,&Monsterspr[PINKY*8+6+a2]);
+			putsprite(FIX_INT(akax)+36,134,&Monsterspr[AOSUKE*8+6+a2]);
+			putsprite(FIX_INT(akax)+54,134,&Monsterspr[GUZUTA*8+6+a2]);
 			if(startkeycheck(1)) return;
-			clrbmpmn(pacx/256,133,XWIDTH_PACMAN,YWIDTH_PACMAN);
-			clrbmpmn(akax/256,134,XWIDTH_MONSTER+54,YWIDTH_MONSTER);
+			clrbmpmn(FIX_INT(pacx),133,XWIDTH_PACMAN,YWIDTH_PACMAN);
+			clrbmpmn(FIX_INT(akax),134,XWIDTH_MONSTER+54,YWIDTH_MONSTER);
 			pacx+=pacspeed;
 			akax+=akaspeed;
 			gamecount++;
@@ -1756,52 +1836,107 @@ void title(void){
 				ac2=4;
 				a2^=1;
 			}
-			if(i<=0) putbmpmn(akax/256,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Ijikebmp[a2]);
-			if(i<=1) putbmpmn(akax/256+18,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Ijikebmp[a2]);
-			if(i<=2) putbmpmn(akax/256+36,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Ijikebmp[a2]);
-			if(i<=3) putbmpmn(akax/256+54,134,XWIDTH_MONSTER,YWIDTH_MONSTER,Ijikebmp[a2]);
-			putbmpmn(pacx/256,133,XWIDTH_PACMAN,YWIDTH_PACMAN,Pacmanbmp[a1]);
+			if(i<=0) putsprite(FIX_INT(akax),134,&Ijikespr[a2]);
+			if(i<=1) putsprite(FIX_INT(akax)+18,134,&Ijikespr[a2]);
+			if(i<=2) putsprite(FIX_INT(akax)+36,134,&Ijikespr[a2]);
+			if(i<=3) putsprite(FIX_INT(akax)+54,134,&Ijikespr[a2]);
+			putsprite(FIX_INT(pacx),133,&Pacmanspr[a1]);
 			if(startkeycheck(1)) return;
-			clrbmpmn(pacx/256,133,XWIDTH_PACMAN,YWIDTH_PACMAN);
+			clrbmpmn(FIX_INT(pacx),133,XWIDTH_PACMAN,YWIDTH_PACMAN);
 			switch(i){
 				case 0:
-					if(pacx/256>akax/256-6){
+					if(FIX_INT(pacx)>FIX_INT(akax)-6){
 						i++;
-						clrbmpmn(akax/256,134,XWIDTH_MONSTER,YWIDTH_MONSTER);
-						putbmpmn(pacx/256,136,XWIDTH_SCORE,YWIDTH_SCORE,Scorebmp[0]);
+						clrbmpmn(FIX_INT(akax),134,XWIDTH_MONSTER,YWIDTH_MONSTER);
+						putsprite(FIX_INT(pacx),136,&Scorespr[0]);
 						if(startkeycheck(30)) return;
 					}
 					break;
 				case 1:
-					if(pacx/256>akax/256+18-6){
+					if(FIX_INT(pacx)>FIX_INT(akax)+18-6){
 						i++;
-						clrbmpmn(akax/256+18,134,XWIDTH_MONSTER,YWIDTH_MONSTER);
-						putbmpmn(pacx/256,136,XWIDTH_SCORE,YWIDTH_SCORE,Scorebmp[1]);
+						clrbmpmn(FIX_INT(akax)+18,134,XWIDTH_MONSTER,YWIDTH_MONSTER);
+						putsprite(FIX_INT(pacx),136,&Scorespr[1]);
 						if(startkeycheck(30)) return;
 					}
 					break;
 				case 2:
-					if(pacx/256>akax/256+36-6){
+					if(FIX_INT(pacx)>FIX_INT(akax)+36-6){
 						i++;
-						clrbmpmn(akax/256+36,134,XWIDTH_MONSTER,YWIDTH_MONSTER);
-						putbmpmn(pacx/256,136,XWIDTH_SCORE,YWIDTH_SCORE,Scorebmp[2]);
+						clrbmpmn(FIX_INT(akax)+36,134,XWIDTH_MONSTER,YWIDTH_MONSTER);
+						putsprite(FIX_INT(pacx),136,&Scorespr[2]);
 						if(startkeycheck(30)) return;
 					}
 					break;
 				case 3:
-					if(pacx/256>akax/256+54-6){
+					if(FIX_INT(pacx)>FIX_INT(akax)+54-6){
 						i++;
-						clrbmpmn(akax/256+54,134,XWIDTH_MONSTER,YWIDTH_MONSTER);
-						putbmpmn(pacx/256,136,XWIDTH_SCORE,YWIDTH_SCORE,Scorebmp[3]);
+						clrbmpmn(FIX_INT(akax)+54,134,XWIDTH_MONSTER,YWIDTH_MONSTER);
+						putsprite(FIX_INT(pacx),136,&Scorespr[3]);
 						if(startkeycheck(30)) return;
 					}
 			}
-			clrbmpmn(akax/256,134,XWIDTH_MONSTER+54,YWIDTH_MONSTER);
+			clrbmpmn(FIX_INT(akax),134,XWIDTH_MONSTER+54,YWIDTH_MONSTER);
 			pacx+=pacspeed;
 			akax+=akaspeed;
 		}
 	}
 }
+static void gameframe(uint32_t k){
+	//ゲーム中の1フレーム分の処理。ボタン状態k
+	gamecount++;
+	savechars();	//キャラクター表示範囲記録
+	pac_keycheck(k);	//ボタン押下チェック
+	movechars();	//キャラクター移動
+	if(!headless) movedisplaychars();	//キャラクター表示範囲の書き直し
+	fruitcheck();	//フルーツ関係チェック
+	huntedcheck();	//食った、食われたチェック
+	if(!headless) displayscore();	//スコア表示
+}
+void pacman_reset(unsigned char h){
+	//ゲームを開始して1面のゲーム中の状態にする。h=1のときは表示しない
+	headless=h;
+	gameinit();
+	gameinit2();
+	gameinit3();
+	gamecount=0;
+	gameinit4();
+	player--; //gamestart()と同じく1人目を場に出す
+	gamestatus=1;
+}
+unsigned char pacman_step(uint32_t keys,_GameState *st){
+	//ボタン状態keysで1フレーム進め、状態をstに返す
+	//やられたときと面クリアのアニメーション、ウェイトは省略して次のゲーム中の状態に進める
+	//戻り値 1:ゲーム中、4:ゲームオーバー（pacman_reset()まで進まない）
+	unsigned char i;
+	if(gamestatus==1){
+		gameframe(keys);
+		if(gamestatus==2){
+			if(player==0) gamestatus=4;//ゲームオーバー
+			else player--;
+		}
+		else if(gamestatus==3) gameinit3();
+		if(gamestatus==2 || gamestatus==3){
+			gamecount=0;
+			gameinit4();
+			gamestatus=1;
+		}
+	}
+	if(st!=NULL){
+		st->score=score;
+		st->stage=stage;
+		st->player=player;
+		st->cookie=cookie;
+		st->gamestatus=gamestatus;
+		st->gamecount=gamecount;
+		for(i=0;i<5;i++) st->chars[i]=*chars[i];
+		st->wallbits=wallbits;
+		st->cookiebits=cookiebits;
+		st->powerbits=powerbits;
+		st->doorbits=doorbits;
+	}
+	return gamestatus;
+}
 void game(void){
 	gameinit2();//スコアなど初期化
 	gamestatus=0;//0:ゲームスタート、1:ゲーム中、2:プレイヤー1減、3:ステージクリア、4:ゲームオーバー
@@ -1813,19 +1948,13 @@ void game(void){
 			gameinit4();//パックマン、モンスター位置初期化など
 			gamestart();//Ready!表示
 			gamestatus=1;
+			sound_step(SOUND_EFFECT,sound); //効果音出力開始
+			sound_step(SOUND_EFFECT2,eventsound);
 			while(gamestatus==1){
 				wait60thsec(1);
-				gamecount++;
-				sound();		//効果音出力
-				erasechars();	//キャラクター表示消去
-				pac_keycheck();		//ボタン押下チェック
-				movechars();	//キャラクター移動
-				displaychars();	//キャラクター表示
-				fruitcheck();	//フルーツ関係チェック
-				huntedcheck();	//食った、食われたチェック
-				displayscore();	//スコア表示
+				gameframe(get_pad_vmask());
 			}
-			sound_off();//サウンド停止
+			sound_stop_all();//サウンド停止
 			set_palette(COLOR_POWERCOOKIE,0,255,255);//パワーえさの色標準に戻す
 			if(gamestatus==2){
 				deadanim(); //パックマンやられた時のアニメーション
@@ -1847,6 +1976,7 @@ void pacman_main() {
     init_graphic(); //液晶利用開始
     LCD_WriteComm(0x37); //画面中央にするためスクロール設定
     LCD_WriteData2(272);
+    render_start(); //以後の描画はレンダーワーカーが行う
 
 	highscore=1000;
 	gameinit(); //ゲーム全体初期化
@@ -36,13 +36,4 @@ typedef struct {
 	int8_t rot; //回転可能回数、これを越えると初期位置に戻す
 } _Block;
 
-//_Music構造体定義
-typedef struct {
-	unsigned char *p; //曲配列の演奏中の位置
-	unsigned char *startp; //曲配列のリピート位置
-	unsigned char count; //発音中の音カウンタ
-	unsigned short pr; //発音中の音（タイマ周期）
-	unsigned char stop; //0:演奏中、1:終了
-} _Music;
-
 extern const unsigned char FontData[256*8];
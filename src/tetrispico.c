@@ -1,6 +1,7 @@
 // テトリス（カラーグラフィック液晶版） Tetris for Raspberry Pi Pico by K.Tanaka
 
 #include <stdlib.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
 #include "hardware/spi.h"
@@ -8,8 +9,13 @@
 #include "picogames.h"
 
 unsigned char cursorx,cursory,cursorc;
-unsigned char board[25][12]; //ブロックを配置する配列
-unsigned char boardchange[25][12]; //board配列が変化したかを表す配列
+unsigned char board[25][12]; //ブロックを配置する配列（カラー番号）
+static uint16_t boardbits[25]; //board配列の各行で、ブロックか壁のあるx番目のビットを1にしたもの
+#define CELLBIT(x) (1u<<(x))
+#define FULLLINE 0x7fe //x=1～10のビット、全て1なら行が完成
+static void drawblock(int x,int y,unsigned char tile,unsigned char color);
+static TILEMAP boardmap={12*8,8,10,23,12,8,8,&board[1][1],NULL,drawblock}; //board配列の(1,1)-(10,23)を表示するタイルマップ
+#define BOARDCHANGE(y,bits) tilemap_dirty_row(&boardmap,(y)-1,(bits)>>1) //board[y]のbitsのセルが変化したことを記録
 static unsigned int score,highscore; //得点、ハイスコア
 unsigned int gcount=0; //カウンタ、乱数の種に使用
 uint32_t keyold; //前回キー入力状態（リピート入力防止用）
@@ -42,8 +48,7 @@ const _Block block[7]={
 _Block falling; //現在落下中のブロックの構造体
 unsigned char blockx,blocky,blockangle,blockno; //現在落下中のブロックの座標、向き、種類
 
-static _Music music; //演奏中の音楽構造体
-const unsigned short *sounddatap; //ブロック着地効果音配列の位置、演奏中の音楽よりこちらを優先
+const unsigned short * volatile sounddatap; //ブロック着地効果音配列の位置、演奏中の音楽よりこちらを優先
 
 //sounddata配列　ド～上のド～その上のドの周期カウンタ値
 // 31250/(440*power(2,k/12))*16  kはラからの差分、低音にいくほどマイナス
@@ -166,68 +171,20 @@ static unsigned char startkeycheck(unsigned short n){
 	// 60分のn秒ウェイト
 	// スタートボタンが押されればすぐ戻る
 	//　戻り値　スタートボタン押されれば1、押されなければ0
-	uint64_t t=to_us_since_boot(get_absolute_time())%16667;
 	while(n--){
-		sleep_us(16667-t);
-                if (get_pad_vmask() & KEYSTART)
-                       return 1;
-		t=0;
+		wait60thsec(1);
+		if (get_pad_vmask() & KEYSTART)
+			return 1;
 	}
 	return 0;
 }
 
-void playmusic1step(void){
-	//演奏中の曲を1つ進める
-	if(music.stop) return; //演奏終了済み
-	music.count--;
-	if(music.count>0){
-		sound_on(music.pr);
-		return;
-	}
-	//次の音を鳴らす
-	if(*music.p==254){ //曲終了
-		music.stop=1;
-		music.pr=0;
-		sound_off();
-		return;
-	}
-	if(*music.p==253){ //曲の最初に戻る
-		music.p=music.startp;
-	}
-	if(*music.p==255){
-		music.pr=0;
-		sound_off(); //休符
-	}
-	else{
-		music.pr=sounddata[*music.p]; //周期データ
-		sound_on(music.pr);
-	}
-	music.p++;
-	music.count=*music.p; //音符長さ
-	music.p++;
-}
-
-static void sound(void);//プロトタイプ宣言
-static void playmusic60thsec(void){
-	//60分の1秒ウェイト後、現在演奏中の曲を1つ進める
-	wait60thsec(1); //60分の1秒ウェイト
-//	playmusic1step();
-	sound();
-}
-void wait60thsecmusic(unsigned short n){
-	//60分のn秒間、曲を演奏しながらウェイト
-	while(n--) playmusic60thsec();
-}
-static void startmusic(unsigned char *m){
-	music.p=m;
-	music.startp=m;
-	music.count=1;
-	music.stop=0;
+static void startmusic(const unsigned char *m){
+	//曲の演奏開始、以後はサウンドエンジンがタイマー割り込みで演奏
+	sound_music(SOUND_MUSIC,m,sounddata);
 }
 static void stopmusic(void){
-	music.stop=1;
-	music.pr=0;
-	sound_off();
+	sound_stop_all();
 }
 
 void locate(unsigned char x,unsigned char y,unsigned char c){
@@ -282,59 +239,75 @@ void printnext(void){
 	printchar(27+bp->x3,21+bp->y3,bp->color,CODE_BLOCK);
 }
 
+static void drawblock(int x,int y,unsigned char tile,unsigned char color){
+//タイルマップから呼ばれ、board配列のカラー番号tileのブロックを表示
+	putfont(x,y,tile,0,CODE_BLOCK);
+}
 void show(void){
-//board配列の内容を画面に表示
-	int8_t x,y;
-	for(y=1;y<=23;y++){
-		for(x=1;x<=10;x++){
-			if(boardchange[y][x]){
-				printchar(11+x,y,board[y][x],CODE_BLOCK);
-				boardchange[y][x]=0;
-			}
-		}
-	}
+//board配列の変化した部分を画面に表示、横に並んだブロックはまとめて転送
+	tilemap_flush(&boardmap);
 }
 static void displayscore(void){
 //得点表示
 	printnumber6(0,16,7,score);
 	printnumber6(0,19,7,highscore);
 }
+static void blockmask(_Block *bp,int8_t x,int8_t y,uint16_t *m){
+//x,yの位置の_Block構造体bpが占めるセルを、y-2～y+2行目のビットマスクm[0]～m[4]に変換
+	m[0]=m[1]=m[3]=m[4]=0;
+	m[2]=CELLBIT(x);
+	m[2+bp->y1]|=CELLBIT(x+bp->x1);
+	m[2+bp->y2]|=CELLBIT(x+bp->x2);
+	m[2+bp->y3]|=CELLBIT(x+bp->x3);
+}
 int check(_Block *bp,int8_t x,int8_t y){
 //x,yの位置に_Block構造体bl（ポインタ渡し）をおけるかチェック
 //戻り値　0:おける　-1:おけない
-	if(board[y][x]) return -1;
-	if(board[y+bp->y1][x+bp->x1]) return -1;
-	if(board[y+bp->y2][x+bp->x2]) return -1;
-	if(board[y+bp->y3][x+bp->x3]) return -1;
+	uint16_t m[5];
+	int8_t i;
+
+	blockmask(bp,x,y,m);
+	for(i=0;i<5;i++){
+		//ブロックのない行はboardbitsを参照しない（盤の外を読まないため）
+		if(m[i] && (m[i]&boardbits[y-2+i])) return -1;
+	}
 	return 0;
 }
 void putblock(void){
 //board配列に落下中のブロックを書き込み
 	_Block *bp;
+	uint16_t m[5];
+	int8_t i;
 	bp=&falling;
 	board[blocky][blockx]=bp->color;
 	board[blocky+bp->y1][blockx+bp->x1]=bp->color;
 	board[blocky+bp->y2][blockx+bp->x2]=bp->color;
 	board[blocky+bp->y3][blockx+bp->x3]=bp->color;
 
-	boardchange[blocky][blockx]=1;
-	boardchange[blocky+bp->y1][blockx+bp->x1]=1;
-	boardchange[blocky+bp->y2][blockx+bp->x2]=1;
-	boardchange[blocky+bp->y3][blockx+bp->x3]=1;
+	blockmask(bp,blockx,blocky,m);
+	for(i=0;i<5;i++){
+		if(m[i]==0) continue;
+		boardbits[blocky-2+i]|=m[i];
+		BOARDCHANGE(blocky-2+i,m[i]);
+	}
 }
 void eraseblock(void){
 //board配列から落下中のブロックを消去
 	_Block *bp;
+	uint16_t m[5];
+	int8_t i;
 	bp=&falling;
 	board[blocky][blockx]=COLOR_SPACE;
 	board[blocky+bp->y1][blockx+bp->x1]=COLOR_SPACE;
 	board[blocky+bp->y2][blockx+bp->x2]=COLOR_SPACE;
 	board[blocky+bp->y3][blockx+bp->x3]=COLOR_SPACE;
 
-	boardchange[blocky][blockx]=1;
-	boardchange[blocky+bp->y1][blockx+bp->x1]=1;
-	boardchange[blocky+bp->y2][blockx+bp->x2]=1;
-	boardchange[blocky+bp->y3][blockx+bp->x3]=1;
+	blockmask(bp,blockx,blocky,m);
+	for(i=0;i<5;i++){
+		if(m[i]==0) continue;
+		boardbits[blocky-2+i]&=~m[i];
+		BOARDCHANGE(blocky-2+i,m[i]);
+	}
 }
 int newblock(void){
 //次のブロック出現
@@ -366,7 +339,7 @@ void displaylevel(void){
 	//レベル表示
 	printstr2(13,13,7,"LEVEL");
 	printnumber6(14,13,7,level);
-	wait60thsecmusic(60*3);
+	wait60thsec(60*3);
 	printstr2(13,13,0,"        ");
 	printstr2(1,22,0,"     ");
 	printnumber6(0,22,7,lines);
@@ -459,25 +432,23 @@ void moveblock(void){
 	}
 	if(movedflag){
 		if(check(&falling,blockx,blocky+1)){
+			sound_update_begin();
 			sounddatap=soundDong[0]; //着地音
+			sound_update_end();
 		}
 	}
 }
 
 void linecheck(void){
 //完成ラインのチェックと消去、得点加算
-	int8_t x,y,x2,y2,c,cleared,cleared2;
+	int8_t x,y,y2,cleared,cleared2;
 
 	//消去するラインがあれば白いブロックに変更
 	cleared=0;
 	y=blocky+2;
 	if(y>23) y=23;
 	while(y>=blocky-2){
-		c=0;
-		for(x=1;x<=10;x++){
-			if(board[y][x]) c++;
-		}
-		if(c==10){
+		if((boardbits[y]&FULLLINE)==FULLLINE){
 			cleared++;
 			locate(12,y,COLOR_CLEARBLOCK);
 			for(x=1;x<=10;x++) printchar2(CODE_CLEARBLOCK);
@@ -486,18 +457,14 @@ void linecheck(void){
 	}
 	if(cleared==0) return;
 
-	wait60thsecmusic(15); //60分の15秒待ち
+	wait60thsec(15); //60分の15秒待ち
 
 	//白いブロックの行を消去して、一番上に獲得した得点表示
 	y=blocky+2;
 	if(y>23) y=23;
 	cleared2=cleared;
 	while(cleared2>0){
-		c=0;
-		for(x=1;x<=10;x++){
-			if(board[y][x]) c++;
-		}
-		if(c==10){
+		if((boardbits[y]&FULLLINE)==FULLLINE){
 			printstr2(12,y,0,"          ");
 			cleared2--;
 		}
@@ -505,25 +472,19 @@ void linecheck(void){
 	}
 	printnumber6(12,y+1,7,scorearray[cleared-1]);
 
-	wait60thsecmusic(15); //60分の15秒待ち
+	wait60thsec(15); //60分の15秒待ち
 
 	//消去した行の分、全体を落下させる
 	cleared=0;
 	y=blocky+2;
 	if(y>23) y=23;
 	while(y>=blocky-2 && cleared<4){
-		c=0;
-		for(x=1;x<=10;x++){
-			if(board[y][x]) c++;
-		}
-		if(c==10){
+		if((boardbits[y]&FULLLINE)==FULLLINE){
 			cleared++;
-			for(y2=y;y2>0;y2--){
-				for(x2=1;x2<=10;x2++){
-					board[y2][x2]=board[y2-1][x2];
-					boardchange[y2][x2]=1;
-				}
-			}
+			//0～y-1行目を1行ずつ下にずらす
+			memmove(board[1],board[0],y*sizeof board[0]);
+			memmove(&boardbits[1],&boardbits[0],y*sizeof boardbits[0]);
+			for(y2=1;y2<=y;y2++) BOARDCHANGE(y2,FULLLINE);
 		}
 		else y--;
 	}
@@ -534,21 +495,21 @@ void linecheck(void){
 		highscore=score;
 	}
 	lines+=cleared;
+	sound_update_begin();
 	sounddatap=soundDong[cleared]; //消去した行数に合わせた効果音を鳴らす
+	sound_update_end();
 	printnumber6(0,22,7,lines);
 }
-void sound(void){
-	//効果音と曲を出力（効果音優先）
-	//60分の1秒ごとに呼び出し
+static int sound(void){
+	//効果音出力、サウンドエンジンから60分の1秒ごとに呼び出し
+	//鳴らしている間は曲より優先
 	unsigned short pr;//タイマーカウンター値
 
-	playmusic1step();
-	pr=0;
-	if(*sounddatap!=0){
-		pr=(*sounddatap++)/14;
-	}
-	if(pr==1) sound_off();
-	else if(pr!=0) sound_on(pr);
+	if(*sounddatap==0) return SOUND_SKIP;
+	pr=(*sounddatap++)/14;
+	if(pr==0) return SOUND_SKIP;
+	if(pr==1) return SOUND_REST;
+	return pr;
 }
 
 static void gameinit(void){
@@ -633,24 +594,27 @@ static void gameinit2(void){
 	displayscore();
 	next=rand()%7;
 	printnext(); //NEXTの場所に次のブロック表示
+	sound_update_begin();
 	sounddatap=soundDong[0]+SOUNDDONGLENGTH-1;
+	sound_update_end();
+	sound_step(SOUND_EFFECT,sound);
 
 	//ゲームエリアの初期化
-	for(i=0;i<12;i++) {
-		for(y=0;y<25;y++) {
+	for(y=0;y<25;y++) {
+		for(i=0;i<12;i++) {
 			if(i==0 || i==11 || y==24) {
 				board[y][i]=COLOR_WALL;
 			} else {
 				board[y][i]=COLOR_SPACE;
-				boardchange[y][i]=1;
 			}
 		}
+		boardbits[y]=(y==24)?0xfff:CELLBIT(0)|CELLBIT(11);
 	}
+	tilemap_dirty_all(&boardmap);
 }
 
 static void gameinit3(void){
 //各レベルごとに呼ばれる初期化
-	int8_t x,y;
 	lines=0;			//消去ライン数クリア
 	level++;
 
@@ -659,20 +623,16 @@ static void gameinit3(void){
 	else fallspeed-=5;
 
 	//ブロック再描画用処理
-	for(x=1;x<11;x++) {
-		for(y=0;y<24;y++) {
-			boardchange[y][x]=1;
-		}
-	}
+	tilemap_dirty_all(&boardmap);
 
- 	startmusic((unsigned char *)musicdatap[(level-1)%(sizeof musicdatap/sizeof musicdatap[0])]);//各レベルの音楽開始
+ 	startmusic(musicdatap[(level-1)%(sizeof musicdatap/sizeof musicdatap[0])]);//各レベルの音楽開始
         keyold =  get_pad_vmask();
 	srand(gcount);
 }
 void gameover(void){
 //ゲームオーバー
 	printstr2(13,13,7,"GAME OVER");
-	wait60thsecmusic(60*5); //5秒ウェイト
+	wait60thsec(60*5); //5秒ウェイト
 	stopmusic();
 }
 static void title(void){
@@ -737,7 +697,6 @@ static void game(void){
 			else gamestatus=2;
 			while(gamestatus==2){
 				wait60thsec(1);
-				sound();		//効果音出力
 				eraseblock();	//ブロック消去
 				moveblock();	//ブロック移動、着地完了チェック
 				putblock();		//ブロック配置
@@ -0,0 +1,134 @@
+/*
+ * Pico Games
+ *
+ * Tile map layer
+ *
+ * Each row has a dirty bit per tile. tilemap_flush() scans the rows,
+ * and a run of dirty tiles next to each other is composed into one
+ * rectangle and sent to LCD as one address window, as long as it fits
+ * in the compose buffer. The tile and color arrays belong to the game,
+ * so a board array used by the game logic can be the tile array.
+ */
+#include "pico/stdlib.h"
+#include "picogames.h"
+#include "tilemap.h"
+
+static void draw_tile(TILEMAP *tm, int x, int y)
+{
+  int i = y * tm->pitch + x;
+
+  (*tm->draw)(tm->x + x * tm->tw, tm->y + y * tm->th, tm->tile[i],
+              tm->color ? tm->color[i] : 0);
+}
+
+/*
+ * Draw tiles x1 to x2 of row y.
+ */
+static void draw_run(TILEMAP *tm, int x1, int x2, int y)
+{
+  int sx, sy, ex, ey, composed, x;
+
+  sx = tm->x + x1 * tm->tw;
+  sy = tm->y + y * tm->th;
+  ex = tm->x + (x2 + 1) * tm->tw - 1;
+  ey = sy + tm->th - 1;
+  composed = x2 > x1 && compose_begin(sx, sy, ex, ey);
+  for (x = x1; x <= x2; x++)
+    draw_tile(tm, x, y);
+  if (composed)
+    compose_end();
+}
+
+/*
+ * Write tile x, y, it is drawn by next flush if changed.
+ */
+void tilemap_put(TILEMAP *tm, int x, int y, unsigned char tile, unsigned char color)
+{
+  int i = y * tm->pitch + x;
+
+  if (tm->tile[i] == tile && (tm->color == NULL || tm->color[i] == color))
+    return;
+  tm->tile[i] = tile;
+  if (tm->color)
+    tm->color[i] = color;
+  tm->dirty[y] |= 1u << x;
+}
+
+/*
+ * Write all tiles without drawing, when the screen is cleared to them.
+ */
+void tilemap_fill(TILEMAP *tm, unsigned char tile, unsigned char color)
+{
+  int x, y;
+
+  for (y = 0; y < tm->h; y++)
+  {
+    for (x = 0; x < tm->w; x++)
+    {
+      tm->tile[y * tm->pitch + x] = tile;
+      if (tm->color)
+        tm->color[y * tm->pitch + x] = color;
+    }
+    tm->dirty[y] = 0;
+  }
+}
+
+/*
+ * Draw tile x, y by next flush. Tiles outside of the map are ignored.
+ */
+void tilemap_dirty(TILEMAP *tm, int x, int y)
+{
+  if (x >= 0 && x < tm->w && y >= 0 && y < tm->h)
+    tm->dirty[y] |= 1u << x;
+}
+
+/*
+ * Draw tiles of row y whose bits are set by next flush.
+ */
+void tilemap_dirty_row(TILEMAP *tm, int y, uint32_t bits)
+{
+  if (y >= 0 && y < tm->h)
+    tm->dirty[y] |= (tm->w < 32) ? bits & ((1u << tm->w) - 1) : bits;
+}
+
+void tilemap_dirty_all(TILEMAP *tm)
+{
+  int y;
+
+  for (y = 0; y < tm->h; y++)
+    tm->dirty[y] = (tm->w < 32) ? (1u << tm->w) - 1 : 0xffffffff;
+}
+
+/*
+ * Draw tile x, y now, for example under a sprite being composed.
+ */
+void tilemap_draw(TILEMAP *tm, int x, int y)
+{
+  tm->dirty[y] &= ~(1u << x);
+  draw_tile(tm, x, y);
+}
+
+/*
+ * Draw all dirty tiles.
+ */
+void tilemap_flush(TILEMAP *tm)
+{
+  int y, x1, x2, max;
+  uint32_t d;
+
+  max = COMPOSE_SIZE / (tm->tw * tm->th);	/* tiles in a window */
+  for (y = 0; y < tm->h; y++)
+  {
+    d = tm->dirty[y];
+    tm->dirty[y] = 0;
+    while (d)
+    {
+      x1 = __builtin_ctz(d);
+      x2 = x1;
+      while (x2 + 1 < tm->w && x2 + 1 - x1 < max && (d >> (x2 + 1) & 1))
+        x2++;
+      d &= ~(((2u << x2) - 1) & ~((1u << x1) - 1));
+      draw_run(tm, x1, x2, y);
+    }
+  }
+}
@@ -0,0 +1,40 @@
+/*
+ * Pico Games
+ *
+ * Tile map layer, a grid of equally sized tiles drawn by a function of
+ * the game. Games write tiles or mark them dirty, and tilemap_flush()
+ * draws only the dirty tiles.
+ */
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <stdint.h>
+
+#define	TILEMAP_ROWS	40	/* max rows, a row has up to 32 tiles */
+
+/*
+ * Draw tile at screen position x, y, painting every dot of it. color is
+ * 0 if the map has no color array.
+ */
+typedef void (*TILE_DRAW)(int x, int y, unsigned char tile, unsigned char color);
+
+typedef struct {
+  short x, y;			/* screen position of tile 0, 0 */
+  unsigned char w, h;		/* size in tiles */
+  unsigned char pitch;		/* array elements from a row to the next */
+  unsigned char tw, th;		/* tile size in dots */
+  unsigned char *tile;		/* tile numbers */
+  unsigned char *color;		/* tile colors, NULL if none */
+  TILE_DRAW draw;
+  uint32_t dirty[TILEMAP_ROWS];	/* bit x of row y is set if tile x, y is to be drawn */
+} TILEMAP;
+
+void tilemap_put(TILEMAP *tm, int x, int y, unsigned char tile, unsigned char color);
+void tilemap_fill(TILEMAP *tm, unsigned char tile, unsigned char color);
+void tilemap_dirty(TILEMAP *tm, int x, int y);
+void tilemap_dirty_row(TILEMAP *tm, int y, uint32_t bits);
+void tilemap_dirty_all(TILEMAP *tm);
+void tilemap_draw(TILEMAP *tm, int x, int y);
+void tilemap_flush(TILEMAP *tm);
+
+#endif
@@ -0,0 +1,34 @@
+# Span list sprite tables generated from bitmap arrays at build time.
+# picogames_sprites(<target>) adds the generated sources to <target>.
+
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+set(PICOGAMES_SRC ${CMAKE_CURRENT_LIST_DIR}/../src)
+set(SPRITEGEN ${CMAKE_CURRENT_LIST_DIR}/spritegen.py)
+
+# name:widthxheight of each bitmap array in pacman2data.c
+set(PACMAN_SPRITES
+	Pacmanbmp:14x14
+	Pacmandeadbmp:14x14
+	Monsterbmp:14x13
+	Ijikebmp:14x13
+	Medamabmp:14x13
+	Fruitbmp:12x14
+	Scorebmp:16x7
+	Bigpacbmp:31x31
+	Pinbmp:1x4
+	Yabukebmp:22x13
+	Yabuke2bmp:14x13
+	Hadakabmp:22x13
+	Titlelogobmp:114x36
+)
+
+function(picogames_sprites target)
+	set(out ${CMAKE_CURRENT_BINARY_DIR}/pacman2sprite.c)
+	add_custom_command(OUTPUT ${out}
+		COMMAND Python3::Interpreter ${SPRITEGEN} ${PICOGAMES_SRC}/pacman2data.c ${out} ${PACMAN_SPRITES}
+		DEPENDS ${SPRITEGEN} ${PICOGAMES_SRC}/pacman2data.c
+		COMMENT "Generating pacman sprite span lists"
+		VERBATIM)
+	target_sources(${target} PRIVATE ${out})
+endfunction()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Convert palette number bitmap arrays to span lists for putsprite().
+#
+# usage: spritegen.py input.c output.c NAME:WxH ...
+#
+# NAME is a "const unsigned char NAME[...]={...};" array in input.c holding
+# one or more W*H bitmaps where color 0 is transparent. For each array a
+# SPRITE table is written to output.c, named with "bmp" replaced by "spr".
+# Each bitmap becomes a list of opaque spans: row, start x, length and the
+# color numbers of the span.
+
+import re
+import sys
+
+
+def parse_arrays(text):
+    text = re.sub(r'/\*.*?\*/', '', text, flags=re.S)
+    text = re.sub(r'//[^\n]*', '', text)
+    arrays = {}
+    for m in re.finditer(r'const\s+unsigned\s+char\s+(\w+)\s*((?:\[[^\]]*\])+)\s*=\s*\{(.*?)\}\s*;', text, re.S):
+        arrays[m.group(1)] = [int(v, 0) for v in re.findall(r'0[xX][0-9a-fA-F]+|\d+', m.group(3))]
+    return arrays
+
+
+def spans(pixels, w, h):
+    out = []
+    for y in range(h):
+        row = pixels[y * w:(y + 1) * w]
+        x = 0
+        while x < w:
+            if row[x] == 0:
+                x += 1
+                continue
+            x0 = x
+            while x < w and row[x] != 0 and x - x0 < 255:
+                x += 1
+            out.append((y, x0, row[x0:x]))
+    return out
+
+
+def main():
+    if len(sys.argv) < 4:
+        sys.exit('usage: spritegen.py input.c output.c NAME:WxH ...')
+    src, dst = sys.argv[1], sys.argv[2]
+    with open(src, encoding='utf-8', errors='surrogateescape') as f:
+        arrays = parse_arrays(f.read())
+    lines = ['// Generated by tools/spritegen.py from %s, do not edit' % src.replace('\\', '/').split('/')[-1],
+             '',
+             '#include "picogames.h"',
+             '']
+    for spec in sys.argv[3:]:
+        name, size = spec.split(':')
+        w, h = (int(v) for v in size.split('x'))
+        if name not in arrays:
+            sys.exit('spritegen.py: %s is not found in %s' % (name, src))
+        data = arrays[name]
+        if w > 255 or h > 255 or len(data) % (w * h):
+            sys.exit('spritegen.py: %s does not hold %dx%d bitmaps' % (name, w, h))
+        out = re.sub(r'bmp$', '', name) + 'spr'
+        blob = []
+        table = []
+        for i in range(len(data) // (w * h)):
+            s = spans(data[i * w * h:(i + 1) * w * h], w, h)
+            table.append((len(blob), len(s)))
+            for y, x, p in s:
+                blob += [y, x, len(p)] + p
+        lines.append('static const unsigned char %s_data[%d]={' % (out, len(blob)))
+        for i in range(0, len(blob), 16):
+            lines.append('\t' + ','.join(str(v) for v in blob[i:i + 16]) + ',')
+        lines.append('};')
+        lines.append('const SPRITE %s[%d]={' % (out, len(table)))
+        for off, n in table:
+            lines.append('\t{%d,%d,%d,%s_data+%d},' % (w, h, n, out, off))
+        lines.append('};')
+        lines.append('')
+    with open(dst, 'w') as f:
+        f.write('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    main()